@@ -0,0 +1,157 @@
+/*
+Array-bound conversion benchmark
+
+Stores the same value tokens into IntArr / DobArr / StrArr sinks
+and prints ns per token for each way of reaching the sink :
+    storeop   the StoreOp resolved by verify(), a single indirect call
+    visit     convert_and_insert through BoundValue::opc(), a switch on
+              the type code then a std::visit per token (the path before StoreOp)
+    direct    convert_as straight into a std::array, the conversion alone
+then times whole parses of the same tokens as argv and as delimited lists.
+
+    g++ -std=c++20 -O2 -I<frozen>/include bench/array_store.cpp -o array_store
+    ./array_store [passes]
+*/
+#include "../static_parser.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+constexpr std::size_t kTokens = 64; // per profile
+
+constexpr auto sctx = sp::make_sctx(
+    sp::dnOpt()["-i"]("--ints").nargs(1).convert(sp::kCodeInt),
+    sp::dnOpt()["-d"]("--dobs").nargs(1).convert(sp::kCodeDob),
+    sp::dnOpt()["-s"]("--strs").nargs(1).convert(sp::kCodeStr),
+    sp::dnOpt()["-I"]("--intlist").nargs(1).convert(sp::kCodeInt).delimiter(','),
+    sp::dnOpt()["-D"]("--doblist").nargs(1).convert(sp::kCodeDob).delimiter(',')
+);
+
+struct Sinks {
+    std::array<sp::IntT, kTokens> ints{};
+    std::array<sp::DobT, kTokens> dobs{};
+    std::array<sp::StrT, kTokens> strs{};
+    std::array<sp::IntT, kTokens> int_list{};
+    std::array<sp::DobT, kTokens> dob_list{};
+    std::size_t int_count = 0, dob_count = 0, str_count = 0, int_list_count = 0, dob_list_count = 0;
+};
+
+auto make_context(Sinks& s) {
+    return sp::make_rctx(sctx,
+        sp::Request(sp::ModProf().bind(sp::IntArr(s.ints, s.int_count)), "-i"),
+        sp::Request(sp::ModProf().bind(sp::DobArr(s.dobs, s.dob_count)), "-d"),
+        sp::Request(sp::ModProf().bind(sp::StrArr(s.strs, s.str_count)), "-s"),
+        sp::Request(sp::ModProf().bind(sp::IntArr(s.int_list, s.int_list_count)), "-I"),
+        sp::Request(sp::ModProf().bind(sp::DobArr(s.dob_list, s.dob_list_count)), "-D")
+    );
+}
+
+struct Tokens {
+    std::vector<std::string> ints, dobs, strs;
+    std::string int_list, dob_list;
+
+    Tokens() {
+        for(std::size_t i = 0; i < kTokens; i++) {
+            ints.push_back(std::to_string(1000003 * (i + 1) % 999983));
+            dobs.push_back(std::to_string(0.37 * static_cast<double>(i) + 1.5));
+            strs.push_back("/srv/data/file_" + std::to_string(i) + ".bin");
+            int_list += (i ? "," : "") + ints.back();
+            dob_list += (i ? "," : "") + dobs.back();
+        }
+    }
+};
+
+template <typename Fn>
+double ns_per_token(std::size_t passes, std::size_t tokens, Fn pass) {
+    pass(); // warm up
+    auto start = std::chrono::steady_clock::now();
+    for(std::size_t p = 0; p < passes; p++) pass();
+    std::chrono::duration<double, std::nano> spent = std::chrono::steady_clock::now() - start;
+    return spent.count() / static_cast<double>(passes * tokens);
+}
+
+// runs every token of tokens through store into profile idx
+template <typename Store>
+void store_all(std::size_t idx, const std::vector<std::string>& tokens, Store&& store) {
+    sp::except::Diagnostic where{.profile_index = static_cast<std::int32_t>(idx)};
+    for(const std::string& token : tokens)
+        if(!store(std::string_view(token), where)) std::abort();
+}
+
+int main(int argc, char** argv) {
+    std::size_t passes = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 20000;
+    Tokens tok;
+    Sinks sinks;
+    auto rctx = make_context(sinks);
+    auto& rmap = rctx.mapper;
+
+    const std::vector<std::string>* per_profile[] = { &tok.ints, &tok.dobs, &tok.strs };
+    const char* names[] = { "int", "double", "string" };
+    std::array<sp::IntT, kTokens> direct_ints{};
+    std::array<sp::DobT, kTokens> direct_dobs{};
+    std::array<sp::StrT, kTokens> direct_strs{};
+
+    std::printf("%-10s %12s %12s %12s   (ns per token, %zu tokens x %zu passes)\n", "sink", "storeop", "visit", "direct", kTokens, passes);
+    for(std::size_t idx = 0; idx < 3; idx++) {
+        const std::vector<std::string>& tokens = *per_profile[idx];
+        sp::mapper::FindPair prof = rmap[idx];
+        const sp::parser::StoreOp& op = rmap.state().stores[idx];
+
+        double storeop = ns_per_token(passes, kTokens, [&] {
+            op.reset(op.sink);
+            store_all(idx, tokens, [&](std::string_view token, const sp::except::Diagnostic& where) {
+                return op(token, *prof.first, where);
+            });
+        });
+        double visit = ns_per_token(passes, kTokens, [&] {
+            auto fill = prof.second->bval.opc();
+            store_all(idx, tokens, [&](std::string_view token, const sp::except::Diagnostic& where) {
+                return sp::parser::convert_and_insert(fill, token, *prof.first, where);
+            });
+        });
+        double direct = ns_per_token(passes, kTokens, [&] {
+            std::size_t at = 0;
+            store_all(idx, tokens, [&](std::string_view token, const sp::except::Diagnostic& where) {
+                auto put = [&](auto val) {
+                    if constexpr (std::is_same_v<decltype(val), sp::IntT>) direct_ints[at++] = val;
+                    else if constexpr (std::is_same_v<decltype(val), sp::DobT>) direct_dobs[at++] = val;
+                    else direct_strs[at++] = val;
+                    return true;
+                };
+                switch(idx) {
+                    case 0 : return sp::parser::convert_as<sp::kCodeInt.value()>(put, token, *prof.first, where);
+                    case 1 : return sp::parser::convert_as<sp::kCodeDob.value()>(put, token, *prof.first, where);
+                    default : return sp::parser::convert_as<sp::kCodeStr.value()>(put, token, *prof.first, where);
+                }
+            });
+        });
+        std::printf("%-10s %12.2f %12.2f %12.2f\n", names[idx], storeop, visit, direct);
+    }
+
+    // whole parses : every token as its own argument, then the same values as two delimited lists
+    std::vector<const char*> spread;
+    const char* flags[] = { "-i", "-d", "-s" };
+    for(std::size_t idx = 0; idx < 3; idx++) {
+        spread.push_back(flags[idx]);
+        for(const std::string& token : *per_profile[idx]) spread.push_back(token.c_str());
+    }
+    const char* lists[] = { "-I", tok.int_list.c_str(), "-D", tok.dob_list.c_str() };
+
+    double argv_ns = ns_per_token(passes, 3 * kTokens, [&] {
+        rmap.reset();
+        sp::parser::parse(rmap, spread.data(), static_cast<int>(spread.size()), sp::parser::DumpSize<1>{});
+    });
+    if((sinks.str_count != kTokens) or (sinks.ints[kTokens - 1] != direct_ints[kTokens - 1])) std::abort();
+    double list_ns = ns_per_token(passes, 2 * kTokens, [&] {
+        rmap.reset();
+        sp::parser::parse(rmap, lists, 4, sp::parser::DumpSize<1>{});
+    });
+    if((sinks.int_list_count != kTokens) or (sinks.dob_list[kTokens - 1] != direct_dobs[kTokens - 1])) std::abort();
+
+    std::printf("\nparse, one token per value   %8.2f ns per value\n", argv_ns);
+    std::printf("parse, delimited lists       %8.2f ns per value\n", list_ns);
+    return 0;
+}
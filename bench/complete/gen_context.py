@@ -0,0 +1,46 @@
+"""
+Writes a program with an N-option context serving __complete
+
+Options are --option_000 ... : the first 26 also get a short name,
+every 10th takes a choice, every 7th a string, the others an int or nothing,
+followed by two posargs. Without __complete the program parses argv.
+
+    python3 bench/complete/gen_context.py 500 > complete_500.cpp
+"""
+import sys
+
+
+def option(i):
+    short = f'["-{chr(ord("a") + i)}"]' if i < 26 else ""
+    kind = "dnOpt" if short else "snOpt"
+    head = f'sp::{kind}(){short}("--option_{i:03d}")'
+    if i % 10 == 0:
+        return f'{head}.nargs(1).choices<"fast", "safe", "debug">().restricted()'
+    if i % 7 == 0:
+        return f"{head}.nargs(1).convert(sp::kCodeStr).restricted()"
+    if i % 2 == 0:
+        return f"{head}.nargs(1).convert(sp::kCodeInt).restricted()"
+    return f"{head}.nargs(0).convert(sp::kCodeNone)"
+
+
+def main():
+    count = int(sys.argv[1]) if len(sys.argv) > 1 else 500
+    profiles = [option(i) for i in range(count)]
+    profiles.append('sp::Posarg()("input").nargs(1).convert(sp::kCodeStr).restricted()')
+    profiles.append('sp::Posarg()("rest").nargs(1).convert(sp::kCodeStr)')
+    body = ",\n    ".join(profiles)
+    print(f"""// generated by bench/complete/gen_context.py {count}
+#include "static_parser.hpp"
+
+constexpr sp::StaticContext sctx{{
+    {body}
+}};
+
+int main(int argc, const char* argv[]) {{
+    if(sp::complete::serve(sctx.smapper, argc, argv)) return 0;
+    return 1;
+}}""")
+
+
+if __name__ == "__main__":
+    main()
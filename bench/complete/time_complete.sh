@@ -0,0 +1,24 @@
+#!/bin/sh
+# Times __complete requests exec-to-exit on a generated context, /bin/true as the floor
+#   FROZEN_INCLUDE=/path/to/frozen/include sh bench/complete/time_complete.sh [options] [runs]
+set -e
+here=$(cd "$(dirname "$0")" && pwd)
+root=$(cd "$here/../.." && pwd)
+out=${BENCH_OUT:-"${TMPDIR:-/tmp}/static_parser_bench"}
+count=${1:-500}
+runs=${2:-300}
+mkdir -p "$out"
+CC=${CC:-cc}
+CXX=${CXX:-g++}
+
+python3 "$here/gen_context.py" "$count" > "$out/complete_$count.cpp"
+$CXX -std=c++20 -O2 -fconstexpr-ops-limit=1000000000 -I"$root" ${FROZEN_INCLUDE:+-I$FROZEN_INCLUDE} \
+    "$out/complete_$count.cpp" -o "$out/complete_$count"
+$CC -O2 "$here/../spawn_time.c" -o "$out/spawn_time"
+
+prog="$out/complete_$count"
+echo "$count options, $runs runs each"
+printf '%-28s ' "/bin/true";                    "$out/spawn_time" "$runs" /bin/true
+printf '%-28s ' "names (--option_4)";           "$out/spawn_time" "$runs" "$prog" __complete --option_4
+printf '%-28s ' "choices (--option_010 '')";    "$out/spawn_time" "$runs" "$prog" __complete --option_010 ""
+printf '%-28s ' "posarg (-a 1 in)";             "$out/spawn_time" "$runs" "$prog" __complete -b -a 1 in
@@ -0,0 +1,120 @@
+/*
+Allocations per parse benchmark
+
+Parses representative command lines in a loop and prints, per line,
+heap allocations and bytes per parse with the time of a parse, next to
+copying the same argv into a std::vector<std::string> (what most parsers
+do first) as the baseline. tests/alloc_test.cpp asserts the zero counts,
+this reports them with the cost that goes with them.
+Thrown exceptions are allocated by the C++ runtime, not operator new,
+failing lines count what the parser itself allocates.
+
+    g++ -std=c++20 -O2 -I<frozen>/include bench/parse_allocations.cpp -o parse_allocations
+    ./parse_allocations [parses per line]
+*/
+#include "../static_parser.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+static std::size_t allocations = 0;
+static std::size_t allocated_bytes = 0;
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    allocated_bytes += size;
+    if(void* ptr = std::malloc(size ? size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+constexpr sp::StaticContext sctx{
+    sp::dnOpt()["-v"]("--verbose").nargs(0).convert(sp::kCodeNone),
+    sp::snOpt()("--color").nargs(0).convert(sp::kCodeNone),
+    sp::dnOpt()["-n"]("--count").nargs(1).convert(sp::kCodeInt).restricted(),
+    sp::dnOpt()["-m"]("--mode").nargs(1).choices<"fast", "safe", "debug">().restricted(),
+    sp::dnOpt()["-w"]("--weights").nargs(1).convert(sp::kCodeDob).delimiter(','),
+    sp::dnOpt()["-o"]("--output").nargs(1).convert(sp::kCodeStr).restricted().required(),
+    sp::Posarg()("files").nargs(1).convert(sp::kCodeStr)
+};
+
+struct Line {
+    const char* name;
+    std::vector<const char*> argv;
+    sp::FlagType flags = 0;
+};
+
+struct Cost {
+    double allocations = 0;
+    double bytes = 0;
+    double ns = 0;
+};
+
+template <typename Step>
+Cost measure(std::size_t runs, Step step) {
+    step(); // warm up
+    std::size_t since = allocations;
+    std::size_t since_bytes = allocated_bytes;
+    auto start = std::chrono::steady_clock::now();
+    for(std::size_t i = 0; i < runs; i++) step();
+    std::chrono::duration<double, std::nano> spent = std::chrono::steady_clock::now() - start;
+    double n = static_cast<double>(runs);
+    return Cost{
+        static_cast<double>(allocations - since) / n,
+        static_cast<double>(allocated_bytes - since_bytes) / n,
+        spent.count() / n
+    };
+}
+
+int main(int argc, char** argv) {
+    std::size_t runs = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 200000;
+
+    sp::IntT count = 0;
+    sp::IntT mode = -1;
+    std::array<sp::DobT, 8> weights{};
+    std::size_t weight_count = 0;
+    sp::StrT output = nullptr;
+    std::array<sp::StrT, 8> files{};
+    std::size_t file_count = 0;
+    auto rctx = sp::make_rctx(sctx,
+        sp::Request(sp::ModProf().bind(sp::IntRef(count)), "-n"),
+        sp::Request(sp::ModProf().bind(sp::IntRef(mode)), "-m"),
+        sp::Request(sp::ModProf().bind(sp::DobArr(weights, weight_count)), "-w"),
+        sp::Request(sp::ModProf().bind(sp::StrRef(output)), "-o"),
+        sp::Request(sp::ModProf().bind(sp::StrArr(files, file_count)), "files")
+    );
+
+    Line lines[] = {
+        { "minimal", { "-o", "out.txt", "a.txt" } },
+        { "options, choice, list", { "-v", "-n", "42", "--mode", "safe", "-w", "0.5,1.5,2.5", "-o", "out.txt", "a.txt", "b.txt" } },
+        { "--name=value", { "--count=7", "--output=out.txt", "a.txt" } },
+        { "abbreviated", { "--verb", "--out", "out.txt", "--cou", "3", "a.txt" }, sp::parser::kAllowAbbrev },
+        { "unknown flag (fails)", { "--unknown", "-o", "out.txt" } },
+        { "bad element (fails)", { "-w", "1,x,3", "-o", "out.txt" } }
+    };
+
+    std::printf("%-24s %22s %22s   (per parse, %zu parses)\n", "", "static_parser", "argv -> std::string", runs);
+    std::printf("%-24s %7s %7s %8s %7s %7s %8s\n", "line", "allocs", "bytes", "ns", "allocs", "bytes", "ns");
+    for(Line& line : lines) {
+        Cost parse = measure(runs, [&] {
+            rctx.reset();
+            try {
+                sp::parser::parse(rctx.mapper, line.argv.data(), static_cast<int>(line.argv.size()), sp::parser::DumpSize<8>{}, line.flags);
+            } catch(const sp::except::ParseError& err) {
+                if(!err.what()[0]) std::abort();
+            }
+        });
+        Cost copy = measure(runs, [&] {
+            std::vector<std::string> args(line.argv.begin(), line.argv.end());
+            if(args.empty()) std::abort();
+        });
+        std::printf("%-24s %7.1f %7.0f %8.1f %7.1f %7.0f %8.1f\n",
+            line.name, parse.allocations, parse.bytes, parse.ns, copy.allocations, copy.bytes, copy.ns);
+    }
+    return 0;
+}
@@ -0,0 +1,95 @@
+/*
+ContextPool contention benchmark
+
+Every worker parses the same request in a loop, three ways :
+    rctx    a RuntimeContext built by make_rctx per request
+    mutex   one shared RuntimeContext behind a std::mutex
+    pool    a ContextPool handle per request
+and prints requests per second for each thread count.
+
+    g++ -std=c++20 -O2 -pthread -I<frozen>/include bench/pool_contention.cpp -o pool_contention
+    ./pool_contention [requests per thread]
+*/
+#include "../static_parser.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+constexpr auto sctx = sp::make_sctx(
+    sp::dnOpt()["-v"]("--verbose").nargs(0).convert(sp::kCodeNone),
+    sp::dnOpt()["-n"]("--count").nargs(1).convert(sp::kCodeInt).restricted(),
+    sp::dnOpt()["-t"]("--timeout").nargs(1).convert(sp::kCodeDob).restricted(),
+    sp::dnOpt()["-o"]("--output").nargs(1).convert(sp::kCodeStr).restricted(),
+    sp::Posarg()("files").nargs(1).convert(sp::kCodeStr)
+);
+
+// owns its sinks, as the pool requires
+struct Request {
+    sp::IntT count = 0;
+    sp::DobT timeout = 0;
+    sp::StrT output = nullptr;
+    std::array<sp::Blob, 4> files{};
+    decltype(sp::make_rctx(sctx)) rctx;
+
+    Request() : rctx(sp::make_rctx(sctx,
+        sp::Request(sp::ModProf().bind(sp::IntRef(count)), "-n"),
+        sp::Request(sp::ModProf().bind(sp::DobRef(timeout)), "-t"),
+        sp::Request(sp::ModProf().bind(sp::StrRef(output)), "-o"),
+        sp::Request(sp::ModProf().bind(sp::TrackSpan(files)), "files")
+    )) {}
+
+    Request(const Request&) = delete;
+    void clear() { rctx.clear(); }
+};
+
+const char* request_argv[] = { "-v", "-n", "42", "--timeout", "1.5", "-o", "out.txt", "a.txt", "b.txt" };
+constexpr int request_argc = sizeof(request_argv) / sizeof(request_argv[0]);
+
+void parse(Request& req) {
+    sp::parser::parse(req.rctx.mapper, request_argv, request_argc, sp::parser::DumpSize<4>{});
+    if(req.count != 42) std::abort();
+}
+
+template <typename Work>
+double requests_per_second(std::size_t threads, std::size_t per_thread, Work work) {
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for(std::size_t t = 0; t < threads; t++)
+        workers.emplace_back([&] { for(std::size_t i = 0; i < per_thread; i++) work(); });
+    for(auto& worker : workers) worker.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(threads * per_thread) / elapsed.count();
+}
+
+int main(int argc, const char* argv[]) {
+    std::size_t per_thread = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 200000;
+
+    std::printf("%8s %14s %14s %14s\n", "threads", "rctx req/s", "mutex req/s", "pool req/s");
+    for(std::size_t threads : { 1, 2, 4, 8, 16, 32, 64 }) {
+        double fresh = requests_per_second(threads, per_thread, [] {
+            Request req;
+            parse(req);
+        });
+
+        Request shared;
+        std::mutex lock;
+        double locked = requests_per_second(threads, per_thread, [&] {
+            std::lock_guard<std::mutex> guard(lock);
+            parse(shared);
+            shared.clear();
+        });
+
+        sp::pool::ContextPool<Request> pool(threads, [] { return Request(); });
+        double pooled = requests_per_second(threads, per_thread, [&] {
+            auto handle = pool.acquire();
+            parse(*handle);
+        });
+
+        std::printf("%8zu %14.0f %14.0f %14.0f\n", threads, fresh, locked, pooled);
+    }
+    return 0;
+}
@@ -0,0 +1,62 @@
+"""
+Writes a minimal program parsing `--option_000 5` with N options
+
+    python3 bench/startup/gen_program.py sp 500 > sp_500.cpp          static_parser, constinit context
+    python3 bench/startup/gen_program.py getopt 500 > getopt_500.c    getopt_long baseline
+
+--option_000 takes an int, the others take nothing.
+Both programs exit 0 only when the value was parsed.
+"""
+import sys
+
+
+def static_parser(count):
+    profiles = ['sp::snOpt()("--option_000").nargs(1).convert(sp::kCodeInt).restricted()']
+    profiles += [f'sp::snOpt()("--option_{i:03d}").nargs(0).convert(sp::kCodeNone)' for i in range(1, count)]
+    body = ",\n    ".join(profiles)
+    return f"""// generated by bench/startup/gen_program.py sp {count}
+#include "static_parser.hpp"
+
+constinit const sp::StaticContext sctx{{
+    {body}
+}};
+
+int main(int argc, const char* argv[]) {{
+    sp::IntT value = 0;
+    auto rctx = sp::make_rctx(sctx, sp::Request(sp::ModProf().bind(sp::IntRef(value)), "--option_000"));
+    sp::parser::parse(rctx.mapper, argv + 1, argc - 1, sp::parser::DumpSize<2>{{}});
+    return (value == 5) ? 0 : 1;
+}}"""
+
+
+def getopt(count):
+    options = "\n".join(
+        f'    {{"option_{i:03d}", {"required_argument" if i == 0 else "no_argument"}, 0, {i + 256}}},'
+        for i in range(count)
+    )
+    return f"""// generated by bench/startup/gen_program.py getopt {count}
+#include <getopt.h>
+#include <stdlib.h>
+
+static const struct option options[] = {{
+{options}
+    {{0, 0, 0, 0}}
+}};
+
+int main(int argc, char** argv) {{
+    long value = 0;
+    int opt;
+    while((opt = getopt_long(argc, argv, "", options, 0)) != -1)
+        if(opt == 256) value = strtol(optarg, 0, 10);
+    return (value == 5) ? 0 : 1;
+}}"""
+
+
+def main():
+    kind = sys.argv[1]
+    count = int(sys.argv[2])
+    print(static_parser(count) if kind == "sp" else getopt(count))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,42 @@
+#!/bin/sh
+# Exec-to-exit of minimal parsing programs against a getopt_long baseline
+#   FROZEN_INCLUDE=/path/to/frozen/include sh bench/startup/time_startup.sh [runs] [profile counts...]
+set -e
+here=$(cd "$(dirname "$0")" && pwd)
+root=$(cd "$here/../.." && pwd)
+out=${BENCH_OUT:-"${TMPDIR:-/tmp}/static_parser_bench"}
+runs=${1:-2000}
+[ $# -gt 0 ] && shift
+counts=${*:-"10 100 500"}
+mkdir -p "$out"
+CC=${CC:-cc}
+CXX=${CXX:-g++}
+CXXFLAGS="-std=c++20 -O2 -fconstexpr-ops-limit=1000000000 -I$root ${FROZEN_INCLUDE:+-I$FROZEN_INCLUDE}"
+
+$CC -O2 "$here/../spawn_time.c" -o "$out/spawn_time"
+printf 'int main() { return 0; }\n' > "$out/empty.cpp"
+$CXX -O2 "$out/empty.cpp" -o "$out/empty_cpp"
+
+time_one() {
+    printf '%-34s ' "$1"
+    shift
+    "$out/spawn_time" "$runs" "$@"
+}
+
+echo "$runs runs each, parsing --option_000 5"
+time_one "empty C++ program" "$out/empty_cpp"
+for count in $counts; do
+    python3 "$here/gen_program.py" sp "$count" > "$out/sp_$count.cpp"
+    python3 "$here/gen_program.py" getopt "$count" > "$out/getopt_$count.c"
+    $CXX $CXXFLAGS "$out/sp_$count.cpp" -o "$out/sp_$count"
+    $CXX $CXXFLAGS -static-libstdc++ -static-libgcc "$out/sp_$count.cpp" -o "$out/sp_static_$count"
+    $CC -O2 "$out/getopt_$count.c" -o "$out/getopt_$count"
+
+    if nm -C "$out/sp_$count" | grep -q _GLOBAL__sub_I; then
+        echo "sp_$count has a dynamic initializer"
+        exit 1
+    fi
+    time_one "getopt_long, $count options" "$out/getopt_$count" --option_000 5
+    time_one "static_parser, $count options" "$out/sp_$count" --option_000 5
+    time_one "  static libstdc++" "$out/sp_static_$count" --option_000 5
+done
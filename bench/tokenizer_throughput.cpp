@@ -0,0 +1,116 @@
+/*
+Tokenizer throughput benchmark
+
+Tokenizes several input mixes in place and prints MB/s, next to a
+splitter building one std::string per token (what a shell-words
+library does) as the baseline. Short inputs are tokenized repeatedly
+from a fresh copy, the copy is timed on its own and subtracted.
+
+    g++ -std=c++20 -O2 -I<frozen>/include bench/tokenizer_throughput.cpp -o tokenizer_throughput
+    ./tokenizer_throughput [MB per mix]
+*/
+#include "../static_parser.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct Mix {
+    const char* name;
+    const char* unit; // repeated to build the input
+};
+
+constexpr Mix mixes[] = {
+    { "plain words", "--output out.txt -n 12345 --verbose input_file " },
+    { "quoted", "--name 'some file name' \"double quoted arg\" 'x' " },
+    { "escapes", "plain\\ escaped \"quote \\\" inside\" back\\\\slash " },
+    { "job spec", "run --jobs 8 --timeout 2.5 --tag 'nightly build' \"/srv/data/in put\" /srv/out\n" }
+};
+
+// one std::string per token, quotes and backslashes handled like the tokenizer
+std::size_t split_strings(const std::string& input, std::vector<std::string>& out) {
+    out.clear();
+    std::string curr;
+    bool in_token = false;
+    char quote = 0;
+    for(std::size_t i = 0; i < input.size(); i++) {
+        char c = input[i];
+        if(quote) {
+            if(c == quote) quote = 0;
+            else if((c == '\\') && (quote == '"') && (i + 1 < input.size())) curr += input[++i];
+            else curr += c;
+        } else if((c == ' ') || (c == '\t') || (c == '\n')) {
+            if(in_token) out.push_back(std::move(curr));
+            curr.clear();
+            in_token = false;
+        } else {
+            in_token = true;
+            if((c == '\'') || (c == '"')) quote = c;
+            else if((c == '\\') && (i + 1 < input.size())) curr += input[++i];
+            else curr += c;
+        }
+    }
+    if(in_token) out.push_back(std::move(curr));
+    return out.size();
+}
+
+template <typename Fn>
+double seconds(Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, const char* argv[]) {
+    std::size_t target = ((argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 64) << 20;
+
+    std::printf("%-12s %14s %14s %14s\n", "mix", "large MB/s", "256B MB/s", "strings MB/s");
+    for(const Mix& mix : mixes) {
+        std::string input;
+        while(input.size() < target) input += mix.unit;
+
+        // one large buffer
+        std::vector<const char*> slots(input.size() / 2 + 1);
+        std::string work = input;
+        std::size_t tokens = 0;
+        double large = seconds([&] { tokens = sp::tokenizer::tokenize(work.data(), work.size(), slots); });
+
+        // many short command strings, as an RPC payload would be
+        std::string unit;
+        while(unit.size() < 256) unit += mix.unit;
+        std::size_t rounds = target / unit.size();
+        std::vector<char> buffer(unit.size() + 1);
+        std::array<const char*, 256> short_slots{};
+        std::size_t short_tokens = 0;
+        double copies = seconds([&] {
+            for(std::size_t i = 0; i < rounds; i++) {
+                std::memcpy(buffer.data(), unit.c_str(), unit.size() + 1);
+                short_tokens += static_cast<unsigned char>(buffer[i % unit.size()]);
+            }
+        });
+        double small = seconds([&] {
+            for(std::size_t i = 0; i < rounds; i++) {
+                std::memcpy(buffer.data(), unit.c_str(), unit.size() + 1);
+                short_tokens += sp::tokenizer::tokenize(buffer.data(), unit.size(), short_slots);
+            }
+        }) - copies;
+
+        std::vector<std::string> words;
+        std::size_t string_tokens = 0;
+        double strings = seconds([&] { string_tokens = split_strings(input, words); });
+
+        if(string_tokens != tokens) {
+            std::printf("%s : %zu tokens in place, %zu as strings\n", mix.name, tokens, string_tokens);
+            return 1;
+        }
+
+        double megabytes = static_cast<double>(input.size()) / 1e6;
+        double short_megabytes = static_cast<double>(rounds * unit.size()) / 1e6;
+        std::printf("%-12s %14.0f %14.0f %14.0f\n", mix.name,
+            megabytes / large, short_megabytes / small, megabytes / strings);
+    }
+    return 0;
+}
@@ -0,0 +1,288 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "commons.hpp"
+#include "exceptions.hpp"
+#include "mapper.hpp"
+#include "parser.hpp"
+#include "utils.hpp"
+
+namespace sp {
+
+namespace cache {
+
+/*
+Parse-result memoization
+
+ParseCache sits in front of parser::parse_core, argv is fingerprinted
+with FNV-1a, on a hit the recorded result (called profiles, counters
+and converted values) is pushed back into the bound sinks instead of
+parsing again. Only successful parses are recorded.
+
+StrT values pointing into argv are recorded as (argv index, offset)
+and rebased on the argv of the hit, so recorded results never keep
+pointers to a previous argv.
+
+On replay, immediate callbacks run in profile order before the regular
+callbacks, not interleaved with the tokens as in a full parse.
+A cache is meant to be used with a single RuntimeContext at a time.
+Contexts with kCodeCustom profiles always take the full parse,
+custom values have no Blob form to be recorded.
+*/
+
+/*
+Eviction policies
+
+every entry carries a stamp, the entry with the smallest stamp
+is evicted once the cache is full, the policy decides if a hit
+refreshes the stamp
+*/
+struct LruEviction {
+    static void on_hit(std::uint64_t& stamp, std::uint64_t now) noexcept { stamp = now; }
+};
+
+struct FifoEviction {
+    static void on_hit(std::uint64_t&, std::uint64_t) noexcept {}
+};
+
+struct RecordedValue {
+    Blob value;
+    std::int32_t argv_index = -1; // not negative if value is a StrT inside argv
+    std::uint32_t offset = 0;
+};
+
+struct RecordedProfile {
+    std::uint32_t index = 0;
+    WholeNumT call_count = 0;
+    WholeNumT fulfilled_args = 0;
+    std::uint32_t value_begin = 0;
+    std::uint32_t value_count = 0;
+};
+
+struct RecordedResult {
+    std::vector<RecordedProfile> profiles;
+    std::vector<RecordedValue> values;
+};
+
+inline std::uint64_t fingerprint(
+    const void* owner,
+    const char* const* argv,
+    std::size_t argc,
+    FlagType parse_flags
+) noexcept {
+    std::uint64_t hash = utils::fnv1a(reinterpret_cast<const char*>(&owner), sizeof(owner));
+    hash = utils::fnv1a(reinterpret_cast<const char*>(&parse_flags), sizeof(parse_flags), hash);
+    for(std::size_t i = 0; i < argc; i++)
+        hash = utils::fnv1a(argv[i], std::strlen(argv[i]) + 1, hash); // null acts as separator
+    return hash;
+}
+
+inline void record(
+    mapper::RuntimeView& rmap,
+    const char* const* argv,
+    std::size_t argc,
+    RecordedResult& out
+) {
+    const mapper::RuntimeState& state = rmap.state();
+    out.profiles.clear();
+    out.values.clear();
+
+    utils::for_each_bit(state.called, [&](std::size_t i) {
+        mapper::FindPair complete_prof = rmap[i];
+        RecordedProfile rec{
+            static_cast<std::uint32_t>(i),
+            state.call_count[i],
+            state.fulfilled_args[i],
+            static_cast<std::uint32_t>(out.values.size())
+        };
+
+        complete_prof.second->bval.for_each_value([&](const Blob& val) {
+            RecordedValue rval{val};
+            if(const StrT* str = std::get_if<StrT>(&val)) {
+                for(std::size_t arg_i = 0; arg_i < argc; arg_i++) {
+                    std::size_t len = std::strlen(argv[arg_i]);
+                    if((*str >= argv[arg_i]) && (*str <= (argv[arg_i] + len))) {
+                        rval.argv_index = static_cast<std::int32_t>(arg_i);
+                        rval.offset = static_cast<std::uint32_t>(*str - argv[arg_i]);
+                        break;
+                    }
+                }
+            }
+            out.values.push_back(rval);
+        });
+
+        rec.value_count = static_cast<std::uint32_t>(out.values.size() - rec.value_begin);
+        out.profiles.push_back(rec);
+    });
+}
+
+inline void replay(
+    mapper::RuntimeView& rmap,
+    const RecordedResult& result,
+    const char* const* argv
+) {
+    const mapper::RuntimeState& state = rmap.state();
+
+    for(const RecordedProfile& rec : result.profiles) {
+        mapper::FindPair complete_prof = rmap[rec.index];
+        state.mark_called(rec.index);
+        state.call_count[rec.index] = rec.call_count;
+        state.fulfilled_args[rec.index] = rec.fulfilled_args;
+
+        auto fill = complete_prof.second->bval.opc();
+        for(std::uint32_t i = rec.value_begin; i < (rec.value_begin + rec.value_count); i++) {
+            const RecordedValue& rval = result.values[i];
+            Blob val = rval.value;
+            if(rval.argv_index >= 0)
+                val = StrT(argv[rval.argv_index] + rval.offset);
+
+            std::visit([&fill](auto&& data) {
+                using T = std::decay_t<decltype(data)>;
+                if constexpr (!std::is_same_v<T, std::monostate>)
+                    fill(data);
+            }, val);
+        }
+    }
+
+    for(const RecordedProfile& rec : result.profiles) {
+        mapper::FindPair complete_prof = rmap[rec.index];
+        if(profiles::is_immediate(complete_prof.hot->behave))
+            complete_prof.second->callback(*complete_prof.first, *complete_prof.second);
+    }
+
+    parser::run_callbacks(rmap);
+}
+
+template <typename Policy = LruEviction>
+class ParseCache {
+    private :
+    struct Entry {
+        std::uint64_t hash = 0;
+        std::uint64_t stamp = 0;
+        std::string argv_bytes;
+        RecordedResult result;
+    };
+
+    std::vector<Entry> entries;
+    std::unordered_map<std::uint64_t, std::size_t> slots;
+    std::size_t max_entries;
+    std::uint64_t tick = 0;
+    std::uint64_t hit_count = 0;
+    std::uint64_t miss_count = 0;
+    std::uint64_t eviction_count = 0;
+
+    static bool same_argv(const std::string& bytes, const char* const* argv, std::size_t argc) noexcept {
+        std::size_t pos = 0;
+        for(std::size_t i = 0; i < argc; i++) {
+            std::size_t len = std::strlen(argv[i]) + 1;
+            if(((pos + len) > bytes.size()) or (std::memcmp(bytes.data() + pos, argv[i], len) != 0))
+                return false;
+            pos += len;
+        }
+        return (pos == bytes.size());
+    }
+
+    Entry& claim_entry(std::uint64_t hash) {
+        auto it = slots.find(hash);
+        if(it != slots.end()) return entries[it->second]; // hash collision, overwrite
+
+        std::size_t slot = entries.size();
+        if(slot < max_entries) {
+            entries.emplace_back();
+        } else {
+            slot = 0;
+            for(std::size_t i = 1; i < entries.size(); i++)
+                if(entries[i].stamp < entries[slot].stamp) slot = i;
+            slots.erase(entries[slot].hash);
+            ++eviction_count;
+        }
+        slots[hash] = slot;
+        return entries[slot];
+    }
+
+    public :
+
+    explicit ParseCache(std::size_t capacity) : max_entries(capacity) {
+        if(!capacity)
+            throw except::SetupError("ParseCache capacity of 0 is forbidden");
+        entries.reserve(capacity);
+        slots.reserve(capacity);
+    }
+
+    static bool recordable(const mapper::StaticView& statics) noexcept {
+        for(const profiles::static_profile& sprof : statics.profiles)
+            if(sprof.convert_code == kCodeCustom) return false;
+        return true;
+    }
+
+    // runtime state is reset first, so hits and misses leave the same state behind
+    void parse_core(
+        mapper::RuntimeView& rmap,
+        const char** argv,
+        std::size_t argc,
+        std::span<const char*> dump_slots,
+        FlagType parse_flags = 0
+    ) {
+        if(!recordable(rmap.statics())) {
+            rmap.state().reset();
+            parser::parse_core(rmap, parser::TokenCursor{argv, argc}, dump_slots, parse_flags);
+            return;
+        }
+
+        std::uint64_t hash = fingerprint(rmap.statics().source, argv, argc, parse_flags);
+        rmap.state().reset();
+        ++tick;
+
+        auto it = slots.find(hash);
+        if((it != slots.end()) && same_argv(entries[it->second].argv_bytes, argv, argc)) {
+            Entry& entry = entries[it->second];
+            ++hit_count;
+            Policy::on_hit(entry.stamp, tick);
+            replay(rmap, entry.result, argv);
+            return;
+        }
+
+        ++miss_count;
+        parser::parse_core(rmap, parser::TokenCursor{argv, argc}, dump_slots, parse_flags);
+
+        Entry& entry = claim_entry(hash);
+        entry.hash = hash;
+        entry.stamp = tick;
+        entry.argv_bytes.clear();
+        for(std::size_t i = 0; i < argc; i++)
+            entry.argv_bytes.append(argv[i], std::strlen(argv[i]) + 1);
+        record(rmap, argv, argc, entry.result);
+    }
+
+    template <std::size_t IDCount, std::size_t dump_size>
+    void parse(
+        mapper::RuntimeMapper<IDCount>& rmap,
+        const char** argv,
+        int argc,
+        parser::DumpSize<dump_size>,
+        FlagType parse_flags = 0
+    ) {
+        std::array<const char*, dump_size> dump{};
+        parse_core(rmap, argv, static_cast<std::size_t>(argc), dump, parse_flags);
+    }
+
+    void clear() noexcept {
+        entries.clear();
+        slots.clear();
+    }
+
+    std::size_t size() const noexcept { return entries.size(); }
+    std::size_t capacity() const noexcept { return max_entries; }
+    std::uint64_t hits() const noexcept { return hit_count; }
+    std::uint64_t misses() const noexcept { return miss_count; }
+    std::uint64_t evictions() const noexcept { return eviction_count; }
+};
+
+}
+}
@@ -10,6 +10,7 @@ using NameType = const char*;
 using WholeNumT = std::uint32_t;
 using NumT = std::int32_t;
 using FlagType = std::uint32_t;
+using BitWord = std::uint64_t;
 
 using IntT = int;
 using DobT = double;
@@ -0,0 +1,172 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <span>
+#include <string_view>
+
+#include "commons.hpp"
+#include "mapper.hpp"
+#include "parser.hpp"
+
+namespace sp {
+
+namespace complete {
+
+/*
+Shell completion served from the static tables
+
+`prog __complete <words...>` answers the completion of the last word
+(empty to complete a new word) from the StaticMapper alone : sorted long
+names, the hot records (narg, type) and the posarg order.
+No RuntimeContext is built, nothing is verified nor allocated,
+call serve() first thing in main and exit when it returns true.
+
+Output is one candidate per line, then a hint line for the shell :
+    :done    the candidates are the whole answer
+    :files   complete file names as well (string values)
+    :none    nothing can be suggested (numbers)
+*/
+
+inline constexpr std::string_view kCommand = "__complete";
+
+enum class Hint : std::uint8_t { Done, Files, None };
+
+inline const char* hint_text(Hint hint) noexcept {
+    switch(hint) {
+        case Hint::Done : return ":done";
+        case Hint::Files : return ":files";
+        default : return ":none";
+    }
+}
+
+// candidates of a value of profile idx, prefix is prepended to each of them ("--mode=")
+template <typename Emit>
+Hint value_candidates(
+    const mapper::StaticView& statics,
+    std::size_t idx,
+    std::string_view prefix,
+    std::string_view partial,
+    Emit&& emit
+) {
+    const profiles::static_profile& prof = statics.profiles[idx];
+    const values::type_code::Tcode code = statics.hot[idx].convert_code;
+
+    if(code == kCodeChoice) {
+        for(std::size_t i = 0; i < prof.choices->size(); i++) {
+            std::string_view name(prof.choices->name(i));
+            if(name.starts_with(partial)) emit(prefix, name);
+        }
+        return Hint::Done;
+    }
+    if((code == kCodeStr) or (code == kCodeCustom)) return Hint::Files;
+    return Hint::None;
+}
+
+// long names through the sorted table, short names on a single dash
+template <typename Emit>
+void name_candidates(const mapper::StaticView& statics, std::string_view partial, Emit&& emit) {
+    std::size_t lo = 0;
+    std::size_t hi = statics.sorted_lnames.size();
+    while(lo < hi) {
+        std::size_t mid = lo + ((hi - lo) / 2);
+        if(std::string_view(statics.profiles[statics.sorted_lnames[mid]].lname) < partial) lo = mid + 1;
+        else hi = mid;
+    }
+    for(; lo < statics.sorted_lnames.size(); lo++) {
+        std::string_view name(statics.profiles[statics.sorted_lnames[lo]].lname);
+        if(!name.starts_with(partial)) break;
+        emit(std::string_view{}, name);
+    }
+
+    if(partial.size() > 2) return;
+    for(const profiles::static_profile& prof : statics.profiles)
+        if(prof.sname and std::string_view(prof.sname).starts_with(partial))
+            emit(std::string_view{}, std::string_view(prof.sname));
+}
+
+/*
+words are the arguments after the program name, the last one is completed,
+emit(prefix, candidate) is called for every candidate
+*/
+template <typename Emit>
+Hint candidates(const mapper::StaticView& statics, std::span<const char* const> words, Emit&& emit) {
+    std::string_view partial = words.empty() ? std::string_view{} : std::string_view(words.back());
+    if(!words.empty()) words = words.first(words.size() - 1);
+
+    std::size_t pending = mapper::npos_profile; // option whose values are being typed
+    std::size_t pending_left = 0;
+    std::size_t posarg_words = 0;
+
+    for(const char* word : words) {
+        std::string_view curr(word);
+        if(!curr.empty() && (curr[0] == '-') && !parser::potential_digit(word)) {
+            std::size_t eq_idx = curr.find('=');
+            std::size_t idx = statics[curr.substr(0, eq_idx)];
+            pending = mapper::npos_profile;
+            if((idx != mapper::npos_profile) && statics.hot[idx].narg && (eq_idx == std::string_view::npos)) {
+                pending = idx;
+                pending_left = statics.hot[idx].narg;
+            }
+            continue;
+        }
+
+        if(pending != mapper::npos_profile) {
+            if(pending_left) --pending_left;
+            if(!pending_left && profiles::is_restricted(statics.hot[pending].behave))
+                pending = mapper::npos_profile;
+            continue;
+        }
+
+        ++posarg_words;
+    }
+
+    if(partial.starts_with('-')) {
+        std::size_t eq_idx = partial.find('=');
+        if(eq_idx == std::string_view::npos) {
+            name_candidates(statics, partial, emit);
+            return Hint::Done;
+        }
+        std::size_t idx = statics[partial.substr(0, eq_idx)];
+        if((idx == mapper::npos_profile) or !statics.hot[idx].narg) return Hint::None;
+        return value_candidates(statics, idx, partial.substr(0, eq_idx + 1), partial.substr(eq_idx + 1), emit);
+    }
+
+    if(pending != mapper::npos_profile)
+        return value_candidates(statics, pending, std::string_view{}, partial, emit);
+
+    // the partial word is taken as the last positional token, split as handle_posarg does
+    std::size_t idx = mapper::npos_profile;
+    std::size_t taken = 0;
+    parser::split_posargs(statics, posarg_words + 1, [&](std::size_t order, std::size_t share) {
+        taken += share;
+        if(taken <= posarg_words) return true;
+        idx = statics[mapper::PosargIndex(order)];
+        return false;
+    });
+    if(idx == mapper::npos_profile) return Hint::None;
+    return value_candidates(statics, idx, std::string_view{}, partial, emit);
+}
+
+// answers `argv[0] __complete <words...>` on out and returns true, false for any other command line
+template <std::size_t IDCount>
+bool serve(const mapper::StaticMapper<IDCount>& smapper, int argc, const char* const* argv, std::FILE* out = stdout) {
+    if((argc < 2) or (std::string_view(argv[1]) != kCommand)) return false;
+
+    const mapper::StaticView statics = smapper.view();
+    Hint hint = candidates(
+        statics,
+        std::span<const char* const>(argv + 2, static_cast<std::size_t>(argc - 2)),
+        [out](std::string_view prefix, std::string_view name) {
+            if(!prefix.empty()) std::fwrite(prefix.data(), 1, prefix.size(), out);
+            std::fwrite(name.data(), 1, name.size(), out);
+            std::fputc('\n', out);
+        }
+    );
+    std::fputs(hint_text(hint), out);
+    std::fputc('\n', out);
+    std::fflush(out);
+    return true;
+}
+
+}
+}
@@ -0,0 +1,246 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "commons.hpp"
+#include "exceptions.hpp"
+#include "mapper.hpp"
+#include "parser.hpp"
+
+namespace sp {
+
+namespace config {
+
+/*
+Config-file source
+
+Format, one entry per line :
+    key = value [value...]
+    key                       (nargs(0) options)
+    # comment
+key is either a registered name ("--output", "-o")
+or a long option name without its "--" ("output"),
+values are whitespace separated, "double quotes" keep spaces.
+
+The file is mapped privately (copy-on-write) and tokenized in place,
+separators are overwritten by '\0' so every key and value is
+a null-terminated view into the mapping, nothing is copied.
+StrT values point into the mapping, keep the ConfigFile alive
+as long as they are used.
+*/
+
+// the token views the path or the mapping, formatted before the throw so what() outlives both
+template <typename Error>
+[[noreturn]] inline void fail(const except::Diagnostic& diag) {
+    Error err(diag);
+    err.what();
+    throw err;
+}
+
+struct Entry {
+    const char* key = nullptr;
+    std::uint32_t line = 0;
+    std::uint32_t value_begin = 0;
+    std::uint32_t value_count = 0;
+};
+
+class ConfigFile {
+    private :
+    char* data = nullptr;
+    std::size_t map_size = 0;
+    std::vector<Entry> file_entries;
+    std::vector<const char*> file_values;
+
+    static bool is_blank(char c) noexcept {
+        return (c == ' ') or (c == '\t') or (c == '\r');
+    }
+
+    void map_file(const char* path) {
+        int fd = ::open(path, O_RDONLY);
+        if(fd < 0)
+            fail<except::SetupError>(except::Diagnostic{.kind = except::ErrorKind::ConfigAccess, .token = path, .other_name = "open"});
+
+        struct stat info{};
+        if(::fstat(fd, &info) != 0) {
+            ::close(fd);
+            fail<except::SetupError>(except::Diagnostic{.kind = except::ErrorKind::ConfigAccess, .token = path, .other_name = "stat"});
+        }
+
+        std::size_t size = static_cast<std::size_t>(info.st_size);
+        std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        void* mapping = MAP_FAILED;
+
+        if(size && (size % page)) {
+            // the tail of the last page is zero-filled, data[size] is a valid terminator
+            mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            map_size = size;
+        } else {
+            // empty or page-aligned file, no room left for a terminator in the mapping
+            mapping = ::mmap(nullptr, size + 1, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            map_size = size + 1;
+            if(mapping != MAP_FAILED) {
+                std::size_t got = 0;
+                while(got < size) {
+                    ssize_t n = ::read(fd, static_cast<char*>(mapping) + got, size - got);
+                    if(n <= 0) break;
+                    got += static_cast<std::size_t>(n);
+                }
+            }
+        }
+        ::close(fd);
+
+        if(mapping == MAP_FAILED)
+            fail<except::SetupError>(except::Diagnostic{.kind = except::ErrorKind::ConfigAccess, .token = path, .other_name = "map"});
+        data = static_cast<char*>(mapping);
+        try {
+            tokenize(size);
+        } catch(...) {
+            release();
+            throw;
+        }
+    }
+
+    void tokenize(std::size_t size) {
+        std::size_t i = 0;
+        std::uint32_t line = 0;
+
+        while(i < size) {
+            ++line;
+            while((i < size) && is_blank(data[i])) ++i;
+            if((i == size) or (data[i] == '\n') or (data[i] == '#') or (data[i] == ';')) {
+                while((i < size) && (data[i] != '\n')) ++i;
+                ++i;
+                continue;
+            }
+
+            Entry entry{data + i, line, static_cast<std::uint32_t>(file_values.size())};
+            while((i < size) && !is_blank(data[i]) && (data[i] != '=') && (data[i] != '\n')) ++i;
+            while((i < size) && is_blank(data[i])) data[i++] = '\0';
+
+            bool line_end = (i == size) or (data[i] == '\n');
+            if(!line_end && (data[i] == '=')) data[i++] = '\0';
+
+            while(!line_end) {
+                while((i < size) && is_blank(data[i])) ++i;
+                if((i == size) or (data[i] == '\n')) break;
+
+                char* token = data + i;
+                if(data[i] == '"') {
+                    token = data + (++i);
+                    while((i < size) && (data[i] != '"') && (data[i] != '\n')) ++i;
+                    if((i == size) or (data[i] != '"'))
+                        throw except::ParseError(except::Diagnostic{.kind = except::ErrorKind::ConfigQuote, .amount = line});
+                } else {
+                    while((i < size) && !is_blank(data[i]) && (data[i] != '\n')) ++i;
+                }
+
+                line_end = (i == size) or (data[i] == '\n');
+                data[i] = '\0';
+                if(!line_end) ++i;
+                file_values.push_back(token);
+            }
+            if((i < size) && (data[i] == '\n')) data[i] = '\0';
+            data[i++] = '\0';
+
+            entry.value_count = static_cast<std::uint32_t>(file_values.size() - entry.value_begin);
+            file_entries.push_back(entry);
+        }
+    }
+
+    void release() noexcept {
+        if(data) ::munmap(data, map_size);
+        data = nullptr;
+    }
+
+    public :
+
+    explicit ConfigFile(const char* path) { map_file(path); }
+
+    ConfigFile(const ConfigFile&) = delete;
+    ConfigFile& operator=(const ConfigFile&) = delete;
+
+    ConfigFile(ConfigFile&& oth) noexcept
+        : data(std::exchange(oth.data, nullptr)), map_size(oth.map_size),
+          file_entries(std::move(oth.file_entries)), file_values(std::move(oth.file_values)) {}
+
+    ConfigFile& operator=(ConfigFile&& oth) noexcept {
+        if(this != &oth) {
+            release();
+            data = std::exchange(oth.data, nullptr);
+            map_size = oth.map_size;
+            file_entries = std::move(oth.file_entries);
+            file_values = std::move(oth.file_values);
+        }
+        return *this;
+    }
+
+    ~ConfigFile() { release(); }
+
+    std::span<const Entry> entries() const noexcept { return file_entries; }
+
+    std::span<const char* const> values(const Entry& entry) const noexcept {
+        return std::span<const char* const>(file_values).subspan(entry.value_begin, entry.value_count);
+    }
+};
+
+/*
+Feeds every config entry into the runtime context,
+config values mark a profile as called but leave its call_count
+and fulfilled_args at 0, so a later argv call of the same profile
+starts over and replaces the config value (argv takes precedence).
+Required checks and callbacks are left to the parse that follows.
+*/
+inline void apply(mapper::RuntimeView& rmap, const ConfigFile& cfg) {
+    const mapper::RuntimeState& state = rmap.state();
+
+    for(const Entry& entry : cfg.entries()) {
+        std::string_view key(entry.key);
+        mapper::FindPair complete_prof = rmap[key];
+        if(!complete_prof.first and !key.starts_with('-'))
+            complete_prof = rmap.bare_long(key);
+        if(!complete_prof.first or complete_prof.first->is_posarg)
+            fail<except::ParseError>(except::Diagnostic{.kind = except::ErrorKind::UnknownConfigKey, .amount = entry.line, .token = key});
+
+        std::span<const char* const> values = cfg.values(entry);
+        parser::TokenCursor get{values.data(), values.size()};
+        state.fulfilled_args[complete_prof.index] = 0;
+        std::string_view rest;
+        try {
+            rest = parser::fetch_and_next(complete_prof, state, get, std::string_view{});
+        } catch(except::ParseError& err) {
+            parser::name_profile(err.diagnostic(), rmap.statics());
+            throw;
+        }
+        if(!rest.empty())
+            fail<except::ParseError>(except::Diagnostic{.kind = except::ErrorKind::ConfigExtraValues, .amount = entry.line, .token = key});
+
+        --state.call_count[complete_prof.index];
+        state.fulfilled_args[complete_prof.index] = 0;
+    }
+}
+
+// config first, argv after, then a single validation and callback pass
+template <std::size_t IDCount, std::size_t dump_size>
+void parse(
+    mapper::RuntimeMapper<IDCount>& rmap,
+    const ConfigFile& cfg,
+    const char** argv,
+    int argc,
+    parser::DumpSize<dump_size>,
+    FlagType parse_flags = 0
+) {
+    std::array<const char*, dump_size> dump{};
+    apply(rmap, cfg);
+    parser::parse_core(rmap, parser::TokenCursor{argv, static_cast<std::size_t>(argc)}, dump, parse_flags);
+}
+
+}
+}
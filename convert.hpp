@@ -0,0 +1,342 @@
+#pragma once
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+#include "commons.hpp"
+#include "exceptions.hpp"
+#include "profiles.hpp"
+#include "utils.hpp"
+#include "values.hpp"
+
+/*
+Opt-in : delimited lists of at least this many elements are converted
+by several threads when the sink can be written in place (link with -pthread).
+0, the default, keeps every list on the parsing thread and <thread> out
+*/
+#ifndef STATIC_PARSER_PARALLEL_LIST_THRESHOLD
+#define STATIC_PARSER_PARALLEL_LIST_THRESHOLD 0
+#endif
+
+#if STATIC_PARSER_PARALLEL_LIST_THRESHOLD > 0
+#include <array>
+#include <thread>
+#endif
+
+namespace sp {
+
+namespace parser {
+
+/*
+Token conversion of the parser
+
+convert_as<Code> converts a token for a type code known at compile time,
+convert_and_insert picks it from the profile at runtime.
+StoreOp is the conversion pre-resolved for a single profile
+(type code x bound sink kind), RuntimeView::verify() resolves one
+per profile so the parse core stores a token with a single indirect call,
+without switching on the code nor visiting the BoundValue variant.
+String sinks also get a bulk operation, a run of posarg tokens is
+then stored with a single call.
+Profiles with a delimiter get store_list, which splits the token
+and stores every element.
+*/
+
+// where carries the profile the input belongs to, kind and token are filled here
+inline void from_chars_result_check(
+    const std::from_chars_result& res,
+    std::string_view input,
+    const except::Diagnostic& where,
+    const char* expected = nullptr
+) {
+    except::ErrorKind kind = except::ErrorKind::Message;
+    if(res.ec == std::errc::invalid_argument) 
+        kind = except::ErrorKind::NotANumber;
+    else if(res.ec == std::errc::result_out_of_range)
+        kind = except::ErrorKind::OutOfRange;
+    else if(res.ptr < (input.data() + input.size()))
+        kind = except::ErrorKind::PartialNumber;
+    else
+        return;
+
+    except::Diagnostic diag = where;
+    diag.kind = kind;
+    diag.token = input;
+    diag.expected = expected;
+    throw except::ParseError(diag);
+}
+
+inline except::ParseError conversion_error(
+    except::ErrorKind kind,
+    std::string_view input,
+    values::type_code::Tcode code,
+    const except::Diagnostic& where
+) noexcept {
+    except::Diagnostic diag = where;
+    diag.kind = kind;
+    diag.token = input;
+    diag.expected = values::type_code::type_name(code);
+    if(kind == except::ErrorKind::UnknownTypeCode)
+        diag.other_name = values::type_code::code_to_str(code);
+    return except::ParseError(diag);
+}
+
+template <std::uint8_t Code, typename FillF>
+bool convert_as(
+    const FillF& fill,
+    std::string_view input,
+    const profiles::static_profile& prof,
+    const except::Diagnostic& where = {}
+) {
+    constexpr values::type_code::Tcode code(Code);
+
+    if(input.empty())
+        throw conversion_error(except::ErrorKind::EmptyToken, input, code, where);
+
+    if constexpr (code == kCodeDob) {
+        DobT buff = 0;
+        from_chars_result_check(
+            std::from_chars(input.data(), input.data() + input.size(), buff),
+            input, where, values::type_code::type_name(code)
+        );
+        return fill(buff);
+    } else if constexpr (code == kCodeInt) {
+        IntT buff = 0;
+        from_chars_result_check(
+            std::from_chars(input.data(), input.data() + input.size(), buff),
+            input, where, values::type_code::type_name(code)
+        );
+        return fill(buff);
+    } else if constexpr (code == kCodeStr) {
+        if(input[input.size()] != '\0')
+            throw conversion_error(except::ErrorKind::NotNullTerminated, input, code, where);
+        return fill(input.data());
+    } else if constexpr (code == kCodeCustom) {
+        return fill(values::CustomToken{input, prof.converter, &where});
+    } else if constexpr (code == kCodeChoice) {
+        NumT idx = prof.choices->find(input);
+        if(idx < 0)
+            throw conversion_error(except::ErrorKind::InvalidChoice, input, code, where);
+        return fill(static_cast<IntT>(idx));
+    } else {
+        throw conversion_error(except::ErrorKind::UnknownTypeCode, input, code, where);
+    }
+}
+
+template <typename FillF>
+bool convert_and_insert(
+    const FillF& fill,
+    std::string_view input,
+    const profiles::static_profile& prof,
+    const except::Diagnostic& where = {}
+) {
+    switch(prof.convert_code.value()) {
+        case kCodeDob.value() : return convert_as<kCodeDob.value()>(fill, input, prof, where);
+        case kCodeInt.value() : return convert_as<kCodeInt.value()>(fill, input, prof, where);
+        case kCodeStr.value() : return convert_as<kCodeStr.value()>(fill, input, prof, where);
+        case kCodeCustom.value() : return convert_as<kCodeCustom.value()>(fill, input, prof, where);
+        case kCodeChoice.value() : return convert_as<kCodeChoice.value()>(fill, input, prof, where);
+        default : throw conversion_error(except::ErrorKind::UnknownTypeCode, input, prof.convert_code, where);
+    }
+}
+
+struct StoreOp {
+    using StoreFn = bool (*)(void* sink, std::string_view input, const profiles::static_profile& prof, const except::Diagnostic& where);
+    using ResetFn = void (*)(void* sink) noexcept;
+    using BulkFn = std::size_t (*)(void* sink, std::span<const StrT> run) noexcept;
+
+    StoreFn store = nullptr;
+    ResetFn reset = nullptr;
+    void* sink = nullptr; // the alternative held by the profile BoundValue
+    BulkFn bulk = nullptr; // kCodeStr into a sink taking whole runs of tokens, null otherwise
+
+    bool operator()(std::string_view input, const profiles::static_profile& prof, const except::Diagnostic& where) const {
+        return store(sink, input, prof, where);
+    }
+};
+
+template <typename Sink, std::uint8_t Code>
+bool store_as(void* sink, std::string_view input, const profiles::static_profile& prof, const except::Diagnostic& where) {
+    Sink& target = *static_cast<Sink*>(sink);
+    return convert_as<Code>([&target](auto&& val) { return target.push_back(val); }, input, prof, where);
+}
+
+template <typename Sink>
+void reset_sink(void* sink) noexcept { static_cast<Sink*>(sink)->track_reset(); }
+
+#if STATIC_PARSER_PARALLEL_LIST_THRESHOLD > 0
+inline constexpr std::size_t max_list_workers = 8;
+
+/*
+Converts the fields of input into out (one slot per field) with up to
+max_list_workers threads, chunks are cut on delimiters so each thread
+knows the slot of its first field. Once a thread can't be created
+the chunks left are converted on the parsing thread. The error of the
+earliest failing chunk is thrown once every chunk is done
+*/
+template <std::uint8_t Code, typename T>
+void convert_list_parallel(
+    std::span<T> out,
+    std::string_view input,
+    const profiles::static_profile& prof,
+    const except::Diagnostic& where
+) {
+    struct Chunk {
+        std::string_view text;
+        std::size_t first = 0;
+        bool failed = false;
+        except::Diagnostic error;
+    };
+
+    // at least half a threshold of elements per thread
+    std::size_t workers = (out.size() / ((STATIC_PARSER_PARALLEL_LIST_THRESHOLD / 2) + 1)) + 1;
+    std::size_t cores = std::thread::hardware_concurrency();
+    if(cores && (workers > cores)) workers = cores;
+    if(workers > max_list_workers) workers = max_list_workers;
+
+    std::array<Chunk, max_list_workers> chunks{};
+    std::size_t used = 0;
+    std::size_t begin = 0;
+    std::size_t element = 0;
+    while(begin <= input.size()) {
+        std::size_t end = input.size();
+        if((used + 1) < workers) {
+            std::size_t cut = begin + ((input.size() - begin) / (workers - used));
+            end = input.find(prof.delimiter, cut);
+            if(end == std::string_view::npos) end = input.size();
+        }
+        chunks[used] = Chunk{.text = input.substr(begin, end - begin), .first = element, .failed = false, .error = {}};
+        element += utils::count_byte(chunks[used].text, prof.delimiter) + 1;
+        ++used;
+        begin = end + 1;
+    }
+
+    auto convert_chunk = [&out, &prof, &where](Chunk& chunk) noexcept {
+        std::size_t idx = chunk.first;
+        try {
+            utils::for_each_field(chunk.text, prof.delimiter, [&](std::string_view field) {
+                convert_as<Code>([&](auto val) { out[idx++] = val; return true; }, field, prof, where);
+            });
+        } catch(except::ParseError& err) {
+            chunk.failed = true;
+            chunk.error = err.diagnostic();
+        }
+    };
+
+    std::array<std::thread, max_list_workers> threads{};
+    bool spawn = true;
+    for(std::size_t i = 1; i < used; i++) {
+        if(spawn) {
+            try {
+                threads[i] = std::thread(convert_chunk, std::ref(chunks[i]));
+            } catch(...) {
+                spawn = false; // std::system_error, restricted or forked process
+            }
+        }
+        if(!spawn) convert_chunk(chunks[i]);
+    }
+    convert_chunk(chunks[0]);
+    for(std::size_t i = 1; i < used; i++)
+        if(threads[i].joinable()) threads[i].join();
+
+    for(std::size_t i = 0; i < used; i++)
+        if(chunks[i].failed) throw except::ParseError(chunks[i].error);
+}
+#endif
+
+/*
+Delimited token, every element is converted into the sink,
+the element is the token of conversion errors so parse reports
+its own offset inside the argument
+*/
+template <typename Sink, std::uint8_t Code>
+bool store_list(void* sink, std::string_view input, const profiles::static_profile& prof, const except::Diagnostic& where) {
+    Sink& target = *static_cast<Sink*>(sink);
+    const std::size_t count = utils::count_byte(input, prof.delimiter) + 1;
+
+    if(count > target.room()) {
+        if(!target.room()) return false; // a full sink stops the fetch, as for a single value
+        except::Diagnostic diag = where;
+        diag.kind = except::ErrorKind::ListOverflow;
+        diag.amount = static_cast<std::int64_t>(count);
+        diag.token = input;
+        throw except::ParseError(diag);
+    }
+
+#if STATIC_PARSER_PARALLEL_LIST_THRESHOLD > 0
+    using T = typename values::code_value<Code>::type;
+    if constexpr (std::is_same_v<Sink, values::TrackingArray<T>> && std::is_arithmetic_v<T>) {
+        if(count >= STATIC_PARSER_PARALLEL_LIST_THRESHOLD) {
+            convert_list_parallel<Code>(target.claim(count), input, prof, where);
+            return true;
+        }
+    }
+#endif
+
+    utils::for_each_field(input, prof.delimiter, [&](std::string_view field) {
+        convert_as<Code>([&target](auto&& val) { return target.push_back(val); }, field, prof, where);
+    });
+    return true;
+}
+
+// run holds non-empty, null-terminated tokens, returns how many fit in the sink
+template <typename Sink>
+std::size_t append_run(void* sink, std::span<const StrT> run) noexcept {
+    return static_cast<Sink*>(sink)->append(run);
+}
+
+inline bool store_nothing(void*, std::string_view, const profiles::static_profile&, const except::Diagnostic&) { return false; }
+inline void reset_nothing(void*) noexcept {}
+
+inline bool store_unknown(void*, std::string_view input, const profiles::static_profile& prof, const except::Diagnostic& where) {
+    throw conversion_error(except::ErrorKind::UnknownTypeCode, input, prof.convert_code, where);
+}
+
+template <typename Sink>
+void resolve_list(StoreOp& op, values::type_code::Tcode code) {
+    if constexpr (requires(const Sink& sink) { sink.room(); }) {
+        switch(code.value()) {
+            case kCodeDob.value() : op.store = &store_list<Sink, kCodeDob.value()>; break;
+            case kCodeInt.value() : op.store = &store_list<Sink, kCodeInt.value()>; break;
+            case kCodeCustom.value() : op.store = &store_list<Sink, kCodeCustom.value()>; break;
+            case kCodeChoice.value() : op.store = &store_list<Sink, kCodeChoice.value()>; break;
+            default : break;
+        }
+    }
+}
+
+// sink keeps pointing into bval, rebinding bval requires resolving again
+inline StoreOp resolve_store(values::BoundValue& bval, const profiles::static_profile& prof) {
+    const values::type_code::Tcode code = prof.convert_code;
+    return bval.visit_sink([code, &prof](auto& sink) -> StoreOp {
+        using Sink = std::decay_t<decltype(sink)>;
+        if constexpr (std::is_same_v<Sink, std::monostate>) {
+            return StoreOp{&store_nothing, &reset_nothing, nullptr};
+        } else {
+            StoreOp op{&store_unknown, &reset_sink<Sink>, &sink};
+            if(prof.delimiter) {
+                resolve_list<Sink>(op, code);
+                return op;
+            }
+            switch(code.value()) {
+                case kCodeDob.value() : op.store = &store_as<Sink, kCodeDob.value()>; break;
+                case kCodeInt.value() : op.store = &store_as<Sink, kCodeInt.value()>; break;
+                case kCodeStr.value() :
+                    op.store = &store_as<Sink, kCodeStr.value()>;
+                    if constexpr (requires(std::span<const StrT> run) { sink.append(run); })
+                        op.bulk = &append_run<Sink>;
+                    break;
+                case kCodeCustom.value() : op.store = &store_as<Sink, kCodeCustom.value()>; break;
+                case kCodeChoice.value() : op.store = &store_as<Sink, kCodeChoice.value()>; break;
+                default : break;
+            }
+            return op;
+        }
+    });
+}
+
+}
+}
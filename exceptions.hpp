@@ -1,8 +1,14 @@
 #pragma once
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <span>
 #include <stdexcept>
+#include <string_view>
 #ifndef STATIC_PARSER_NO_HEAP
 #include <string>
 #endif
+#include "commons.hpp"
 
 namespace sp {
 
@@ -31,6 +37,7 @@ class raw_string_exception : public std::exception {
     const char* what() const noexcept { return msg; }
 };
 
+#ifndef STATIC_PARSER_NO_HEAP
 class string_exception : public std::exception {
     private :
     std::string msg;
@@ -39,36 +46,171 @@ class string_exception : public std::exception {
 
     const char* what() const noexcept { return msg.data(); }
 };
+#endif
 
 class comtime_except : public raw_string_exception {
     public :
     comtime_except(const char* err_msg) : raw_string_exception(err_msg) {};
 };
 
-#ifdef STATIC_PARSER_NO_HEAP
-class ParseError : public raw_string_exception {
-    public :
-    ParseError(const char* err_msg) : raw_string_exception(err_msg) {};
+enum class ErrorKind : std::uint8_t {
+    Message,            // free text, see Diagnostic::message
+    UnknownFlag,
+    AmbiguousFlag,
+    CallLimit,
+    InsufficientNarg,
+    NotANumber,
+    OutOfRange,
+    PartialNumber,
+    EmptyToken,
+    NotNullTerminated,
+    InvalidChoice,
+    ConversionFailed,
+    UnknownTypeCode,
+    WrongType,
+    DumpOverflow,
+    UnexpectedInput,
+    MissingRequired,
+    MutuallyExclusive,
+    OneOfMissing,
+    NotInitialized,
+    UnregisteredName,
+    IndexOutOfBounds,
+    UnterminatedQuote,
+    DanglingEscape,
+    TooManyTokens,
+    ListOverflow,
+    StreamOverflow,
+    ConfigAccess,
+    ConfigQuote,
+    UnknownConfigKey,
+    ConfigExtraValues
 };
 
-class SetupError : public raw_string_exception {
-    public :
-    SetupError(const char* err_msg) : raw_string_exception(err_msg) {}
+/*
+Fixed-size error record, filled at the throw site without
+any allocation, turned into text only on demand.
+
+token views the offending input (argv, dump or command string),
+names point to static storage (profile names, type names).
+argv_index / offset are resolved by parse once the error
+leaves the parse core, -1 when the token is not part of argv
+*/
+struct Diagnostic {
+    ErrorKind kind = ErrorKind::Message;
+    std::int32_t argv_index = -1;
+    std::uint32_t offset = 0;            // byte offset inside argv[argv_index] or the command string
+    std::int32_t profile_index = -1;
+    std::int64_t amount = 0;             // missing nargs, call limit, group id, slot count...
+    std::string_view token{};
+    const char* profile_name = nullptr;
+    const char* other_name = nullptr;    // second profile, given type, quote kind...
+    const char* expected = nullptr;      // expected type name
+    const char* message = nullptr;       // ErrorKind::Message only
+
+    // writes a null-terminated description into out, returns its length (truncated to fit)
+    std::size_t format(std::span<char> out) const noexcept {
+        if(out.empty()) return 0;
+        const int tok_size = static_cast<int>(token.size());
+        const char* tok = token.data() ? token.data() : "";
+        const char* name = profile_name ? profile_name : "<unnamed>";
+        const char* other = other_name ? other_name : "<unnamed>";
+        const long long num = static_cast<long long>(amount);
+        char* buff = out.data();
+        std::size_t size = out.size();
+        int len = 0;
+
+        switch(kind) {
+            case ErrorKind::Message : len = std::snprintf(buff, size, "%s", message ? message : "Unknown error"); break;
+            case ErrorKind::UnknownFlag : len = std::snprintf(buff, size, "Unknown flag was passed : %.*s", tok_size, tok); break;
+            case ErrorKind::AmbiguousFlag : len = std::snprintf(buff, size, "Ambiguous flag was passed : %.*s", tok_size, tok); break;
+            case ErrorKind::CallLimit : len = std::snprintf(buff, size, "Call limit of %lld exceeded for %s", num, name); break;
+            case ErrorKind::InsufficientNarg : len = std::snprintf(buff, size, "Insufficient narg for %s, still needs %lld", name, num); break;
+            case ErrorKind::NotANumber : len = std::snprintf(buff, size, "Input : %.*s, Is not a number", tok_size, tok); break;
+            case ErrorKind::OutOfRange : len = std::snprintf(buff, size, "Input : %.*s, Is out of range", tok_size, tok); break;
+            case ErrorKind::PartialNumber : len = std::snprintf(buff, size, "Can't fully convert %.*s To a number", tok_size, tok); break;
+            case ErrorKind::EmptyToken : len = std::snprintf(buff, size, "convert-insert operation failed, input token is empty"); break;
+            case ErrorKind::NotNullTerminated : len = std::snprintf(buff, size, "Token : %.*s Is not null-terminated", tok_size, tok); break;
+            case ErrorKind::InvalidChoice : len = std::snprintf(buff, size, "Input : %.*s, Is not one of the allowed choices", tok_size, tok); break;
+            case ErrorKind::ConversionFailed : len = std::snprintf(buff, size, "Input : %.*s, Can't be converted", tok_size, tok); break;
+            case ErrorKind::UnknownTypeCode : len = std::snprintf(buff, size, "Unknown type code of %s", other); break;
+            case ErrorKind::WrongType : len = std::snprintf(buff, size, "Wrong type : %s given", other); break;
+            case ErrorKind::DumpOverflow : len = std::snprintf(buff, size, "Dump inputs exceed dump size of %lld", num); break;
+            case ErrorKind::UnexpectedInput : len = std::snprintf(buff, size, "Unexpected dump inputs of %.*s", tok_size, tok); break;
+            case ErrorKind::MissingRequired : len = std::snprintf(buff, size, "A required %s of \"%s\" was not called", other, name); break;
+            case ErrorKind::MutuallyExclusive : len = std::snprintf(buff, size, "Mutually exclusive %s and %s were called together", name, other); break;
+            case ErrorKind::OneOfMissing : len = std::snprintf(buff, size, "At least one option of group %lld is required, such as %s", num, name); break;
+            case ErrorKind::NotInitialized : len = std::snprintf(buff, size, "RuntimeMapper is not initialized"); break;
+            case ErrorKind::UnregisteredName : len = std::snprintf(buff, size, "%.*s is not registered in StaticMapper [RuntimeContext ctor]", tok_size, tok); break;
+            case ErrorKind::IndexOutOfBounds : len = std::snprintf(buff, size, "%lld Index is out of bounds [RuntimeContext ctor]", num); break;
+            case ErrorKind::UnterminatedQuote : len = std::snprintf(buff, size, "Unterminated %s quote at offset %u", other, offset); break;
+            case ErrorKind::DanglingEscape : len = std::snprintf(buff, size, "Dangling escape at offset %u", offset); break;
+            case ErrorKind::TooManyTokens : len = std::snprintf(buff, size, "Too many tokens, only %lld slots available", num); break;
+            case ErrorKind::ListOverflow : len = std::snprintf(buff, size, "List of %lld values doesn't fit the sink of %s", num, name); break;
+            case ErrorKind::StreamOverflow : len = std::snprintf(buff, size, "Stream token %.*s doesn't fit the %s of %lld bytes", tok_size, tok, other, num); break;
+            case ErrorKind::ConfigAccess : len = std::snprintf(buff, size, "Can't %s config file %.*s", other, tok_size, tok); break;
+            case ErrorKind::ConfigQuote : len = std::snprintf(buff, size, "Unterminated quote in config file at line %lld", num); break;
+            case ErrorKind::UnknownConfigKey : len = std::snprintf(buff, size, "Unknown config key : %.*s at line %lld", tok_size, tok, num); break;
+            case ErrorKind::ConfigExtraValues : len = std::snprintf(buff, size, "Too many values for config key %.*s at line %lld", tok_size, tok, num); break;
+        }
+
+        auto used = [&]() -> std::size_t {
+            if(len < 0) return 0;
+            return (static_cast<std::size_t>(len) < size) ? static_cast<std::size_t>(len) : (size - 1);
+        };
+        if(expected && (used() < (size - 1)))
+            len = static_cast<int>(used()) + std::snprintf(buff + used(), size - used(), " (expected %s)", expected);
+        if((argv_index >= 0) && (used() < (size - 1)))
+            len = static_cast<int>(used()) + std::snprintf(buff + used(), size - used(), " at argv[%d], offset %u", argv_index, offset);
+        return used();
+    }
 };
 
-#else
+/*
+Exception carrying a Diagnostic,
+what() formats it into an inline buffer the first time it is called
+*/
+class diagnostic_exception : public std::exception {
+    private :
+    Diagnostic diag;
+    mutable std::array<char, 192> text{};
+    mutable bool formatted = false;
+#ifndef STATIC_PARSER_NO_HEAP
+    std::string owned; // dynamic message of the std::string constructor
+#endif
 
-class ParseError : public string_exception {
     public :
-    ParseError(const std::string& err_msg) : string_exception(err_msg) {};
-    
+    diagnostic_exception(const Diagnostic& record) noexcept : std::exception(), diag(record) {}
+    diagnostic_exception(const char* err_msg) noexcept : std::exception() { diag.message = err_msg; }
+#ifndef STATIC_PARSER_NO_HEAP
+    diagnostic_exception(const std::string& err_msg) : std::exception(), owned(err_msg) {}
+#endif
+
+    Diagnostic& diagnostic() noexcept { return diag; }
+    const Diagnostic& diagnostic() const noexcept { return diag; }
+    ErrorKind kind() const noexcept { return diag.kind; }
+
+    const char* what() const noexcept {
+#ifndef STATIC_PARSER_NO_HEAP
+        if(!owned.empty()) return owned.data();
+#endif
+        if(!formatted) {
+            diag.format(text);
+            formatted = true;
+        }
+        return text.data();
+    }
 };
 
-class SetupError : public string_exception {
+class ParseError : public diagnostic_exception {
     public :
-    SetupError(const std::string& err_msg) : string_exception(err_msg) {};
+    using diagnostic_exception::diagnostic_exception;
 };
 
-#endif
+class SetupError : public diagnostic_exception {
+    public :
+    using diagnostic_exception::diagnostic_exception;
+};
+
+}
 }
-}
\ No newline at end of file
@@ -0,0 +1,128 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "commons.hpp"
+#include "profiles.hpp"
+
+namespace sp {
+
+namespace parser {
+
+/*
+Off-thread post-parse callbacks
+
+Profiles marked independent() have their callback submitted to a
+user executor once the parse succeeded, every other callback still
+runs in-line on the parsing thread, in profile order.
+parse returns a CallbackJoin, join() waits for the submitted callbacks
+and rethrows the first exception one of them threw.
+The destructor joins too (exceptions are then dropped).
+
+An independent callback runs concurrently with the in-line ones and
+with the other independent ones, it must only touch its own profile
+and its own data.
+*/
+
+class CallbackJoin;
+
+namespace detail {
+    struct JoinState {
+        std::atomic<std::size_t> pending{0};
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+
+        void done() noexcept {
+            if(pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                pending.notify_all();
+        }
+
+        void wait() const noexcept {
+            std::size_t left = pending.load(std::memory_order_acquire);
+            while(left) {
+                pending.wait(left, std::memory_order_acquire);
+                left = pending.load(std::memory_order_acquire);
+            }
+        }
+    };
+}
+
+// unit of work handed to the executor, must be invoked exactly once
+struct CallbackTask {
+    const profiles::static_profile* sprof = nullptr;
+    profiles::modifiable_profile* mprof = nullptr;
+    detail::JoinState* join = nullptr;
+
+    void operator()() const noexcept {
+        try {
+            mprof->callback(*sprof, *mprof);
+        } catch(...) {
+            if(!join->failed.exchange(true, std::memory_order_acq_rel))
+                join->error = std::current_exception();
+        }
+        join->done();
+    }
+};
+
+/*
+Type-erased reference to a user executor,
+target is either callable with a CallbackTask or has a submit(CallbackTask),
+it must outlive the parse call only, not the callbacks
+*/
+class Executor {
+    private :
+    void* target = nullptr;
+    void (*submit_fn)(void*, CallbackTask) = nullptr;
+
+    public :
+    template <typename Target>
+        requires (!std::is_same_v<std::remove_cvref_t<Target>, Executor>)
+    Executor(Target& new_target) noexcept
+        : target(std::addressof(new_target)),
+          submit_fn([](void* erased, CallbackTask task) {
+              Target& exec = *static_cast<Target*>(erased);
+              if constexpr (requires { exec.submit(task); }) exec.submit(task);
+              else exec(task);
+          }) {}
+
+    void submit(CallbackTask task) const { submit_fn(target, task); }
+};
+
+class CallbackJoin {
+    private :
+    std::unique_ptr<detail::JoinState> state;
+
+    public :
+    CallbackJoin() : state(std::make_unique<detail::JoinState>()) {}
+
+    CallbackJoin(CallbackJoin&&) noexcept = default;
+    CallbackJoin& operator=(CallbackJoin&& oth) noexcept {
+        if(this != &oth) {
+            if(state) state->wait();
+            state = std::move(oth.state);
+        }
+        return *this;
+    }
+
+    ~CallbackJoin() { if(state) state->wait(); }
+
+    detail::JoinState& shared() noexcept { return *state; }
+
+    bool ready() const noexcept {
+        return !state or (state->pending.load(std::memory_order_acquire) == 0);
+    }
+
+    // waits for every submitted callback, rethrows the first captured exception
+    void join() {
+        if(!state) return;
+        state->wait();
+        if(state->error) std::rethrow_exception(std::exchange(state->error, nullptr));
+    }
+};
+
+}
+}
@@ -3,13 +3,16 @@
 #include <array>
 #include <span>
 #include <utility>
+#include <string_view>
 #include <frozen/unordered_map.h>
 #include <frozen/string.h>
 #include <type_traits>
 
 #include "commons.hpp"
+#include "convert.hpp"
 #include "exceptions.hpp"
 #include "profiles.hpp"
+#include "utils.hpp"
 
 namespace sp {
 
@@ -17,23 +20,91 @@ namespace mapper {
 
 using namespace sp;
 
+/*
+View over a compiled set of profile groups,
+each group is a mask of `words` packed words over profile indices
+*/
+struct GroupTable {
+    std::span<const BitWord> masks;
+    std::span<const NumT> ids;
+    std::size_t words = 0;
+
+    constexpr std::size_t count() const noexcept { return ids.size(); }
+    constexpr std::span<const BitWord> operator[](std::size_t group) const noexcept {
+        return masks.subspan(group * words, words);
+    }
+};
+
+template <std::size_t ProfCount>
+struct CompiledGroups {
+    static constexpr std::size_t words = utils::bit_words(ProfCount);
+    std::array<BitWord, ProfCount * words> masks{};
+    std::array<NumT, ProfCount> ids{};
+    std::size_t count = 0;
+
+    constexpr void insert(NumT id, std::size_t prof_idx) {
+        std::size_t group = 0;
+        while((group < count) && (ids[group] != id)) ++group;
+        if(group == count) ids[count++] = id;
+        utils::bit_set(std::span<BitWord>(masks).subspan(group * words, words), prof_idx);
+    }
+
+    constexpr GroupTable view() const noexcept {
+        return GroupTable{
+            std::span<const BitWord>(masks.data(), count * words),
+            std::span<const NumT>(ids.data(), count),
+            words
+        };
+    }
+};
+
+// index returned by the name / posarg lookups when nothing matches
+inline constexpr std::size_t npos_profile = static_cast<std::size_t>(-1);
+
+/*
+static_profiles is the cold table (names, description, converter...),
+hot_profiles packs what the parse core reads on every token,
+both are indexed by profile index, lookups only hand out indices
+*/
 template <std::size_t ProfCount, std::size_t PosargCount>
 class ProfileTable {
     private :
-    std::array<const profiles::static_profile*, PosargCount> posargs{};
+    std::array<std::size_t, PosargCount> posargs{};
+    std::array<BitWord, utils::bit_words(ProfCount)> required{};
+    CompiledGroups<ProfCount> exclusions{};
+    CompiledGroups<ProfCount> one_ofs{};
     
+    template <std::size_t... Is>
+    static constexpr std::array<profiles::hot_profile, ProfCount> make_hot(
+        const std::array<profiles::static_profile, ProfCount>& profs,
+        std::index_sequence<Is...>
+    ) {
+        return {{ profiles::hot_profile(profs[Is])... }};
+    }
+
     public :
     const std::array<profiles::static_profile, ProfCount> static_profiles;
+    const std::array<profiles::hot_profile, ProfCount> hot_profiles;
     ProfileTable() = delete;
     template<profiles::DenotedProfile... Prof>
     constexpr ProfileTable(const Prof&... raw_rule)
-    : static_profiles({ (raw_rule.profile())... })
+    : static_profiles({ (raw_rule.profile())... }),
+      hot_profiles(make_hot(static_profiles, std::make_index_sequence<ProfCount>{}))
     {
         std::size_t curr_posarg_i = 0;
         std::size_t existing_posarg = 0;
-        const profiles::static_profile** spot = nullptr;
+        std::size_t* spot = nullptr;
+        posargs.fill(npos_profile);
+
+        for(std::size_t i = 0; i < ProfCount; i++) {
+            const profiles::static_profile& prof = static_profiles[i];
+            if(profiles::is_required(prof.behave))
+                utils::bit_set(required, i);
+            if(prof.exclude_point >= 0)
+                exclusions.insert(prof.exclude_point, i);
+            if(prof.group_point >= 0)
+                one_ofs.insert(prof.group_point, i);
 
-        for(const auto& prof : static_profiles) {
             if(prof.is_posarg) {
                 if(existing_posarg >= PosargCount)
                     throw except::comtime_except("Existing posarg exceed template argument PosargCount");
@@ -45,8 +116,8 @@ class ProfileTable {
                 else
                     throw except::comtime_except("Posarg positional order is out of template argument PosargCount reach");
 
-                if(!(*spot))
-                    *spot = &prof;
+                if(*spot == npos_profile)
+                    *spot = i;
                 else
                     throw except::comtime_except("Posarg positional order is occupied by another posarg");
                 ++existing_posarg;
@@ -58,7 +129,15 @@ class ProfileTable {
     }
 
     constexpr std::size_t profile_index(const profiles::static_profile* prof) const { return prof - &static_profiles[0]; }
-    constexpr const std::array<const profiles::static_profile*, PosargCount>& get_posargs() const noexcept { return posargs; }
+    constexpr const std::array<std::size_t, PosargCount>& get_posargs() const noexcept { return posargs; }
+    constexpr const std::array<BitWord, utils::bit_words(ProfCount)>& get_required() const noexcept { return required; }
+    constexpr GroupTable get_exclusions() const noexcept { return exclusions.view(); }
+    constexpr GroupTable get_one_ofs() const noexcept { return one_ofs.view(); }
+};
+
+struct AbbrevMatch {
+    std::size_t index = npos_profile;
+    bool ambiguous = false;
 };
 
 struct PosargIndex {
@@ -66,12 +145,91 @@ struct PosargIndex {
     PosargIndex(std::size_t i) : val(i) {}
 };
 
+// unique-prefix lookup of a long option name, O(log n) over a sorted table of profile indices
+constexpr AbbrevMatch find_abbreviation(
+    std::span<const profiles::static_profile> profs,
+    std::span<const std::size_t> sorted_lnames,
+    std::span<const WholeNumT> lname_lcp,
+    const std::string_view& prefix
+) noexcept {
+    std::size_t lo = 0;
+    std::size_t hi = sorted_lnames.size();
+    while(lo < hi) {
+        std::size_t mid = lo + ((hi - lo) / 2);
+        if(std::string_view(profs[sorted_lnames[mid]].lname) < prefix) lo = mid + 1;
+        else hi = mid;
+    }
+
+    if((lo == sorted_lnames.size()) or !std::string_view(profs[sorted_lnames[lo]].lname).starts_with(prefix))
+        return {};
+    if(((lo + 1) < sorted_lnames.size()) && (lname_lcp[lo + 1] >= prefix.size()))
+        return {npos_profile, true};
+    return {sorted_lnames[lo], false};
+}
+
+/*
+StaticView is the non-template face of a StaticMapper,
+only the name lookup depends on IDCount and it goes
+through a function pointer, so everything consuming
+a StaticView is compiled once per binary
+*/
+struct StaticView {
+    using LookupF = std::size_t (*)(const void*, const std::string_view&);
+
+    const void* source = nullptr;
+    LookupF lookup = nullptr;
+    std::span<const profiles::static_profile> profiles;
+    std::span<const profiles::hot_profile> hot;
+    std::span<const std::size_t> posargs;
+    std::span<const std::size_t> sorted_lnames;
+    std::span<const WholeNumT> lname_lcp;
+    std::span<const BitWord> required;
+    GroupTable exclusions;
+    GroupTable one_ofs;
+
+    const profiles::static_profile* operator[](std::size_t idx) const noexcept {
+        if(idx >= profiles.size()) return nullptr;
+        return &profiles[idx];
+    }
+
+    std::size_t operator[](const PosargIndex& posarg_index) const noexcept {
+        if(posarg_index.val >= posargs.size()) return npos_profile;
+        return posargs[posarg_index.val];
+    }
+
+    std::size_t operator[](const std::string_view& name) const noexcept {
+        return lookup(source, name);
+    }
+
+    std::size_t profile_index(const profiles::static_profile* target) const noexcept {
+        return (target - &profiles[0]);
+    }
+
+    AbbrevMatch abbreviated(const std::string_view& prefix) const noexcept {
+        return find_abbreviation(profiles, sorted_lnames, lname_lcp, prefix);
+    }
+
+    // exact long option lookup by the name without its "--" prefix
+    std::size_t bare_long(const std::string_view& bare) const noexcept {
+        std::size_t lo = 0;
+        std::size_t hi = sorted_lnames.size();
+        while(lo < hi) {
+            std::size_t mid = lo + ((hi - lo) / 2);
+            std::string_view curr = std::string_view(profiles[sorted_lnames[mid]].lname).substr(2);
+            if(curr == bare) return sorted_lnames[mid];
+            if(curr < bare) lo = mid + 1;
+            else hi = mid;
+        }
+        return npos_profile;
+    }
+};
+
 template <std::size_t IDCount>
 class StaticMapper {
     private :
-    using MapType = frozen::unordered_map<frozen::string, const profiles::static_profile*, IDCount>;
+    using MapType = frozen::unordered_map<frozen::string, std::size_t, IDCount>;
     
-    constexpr void verify_relation(const profiles::static_profile* target, profiles::NameType name) {
+    constexpr void verify_relation(std::size_t target, profiles::NameType name) {
         auto it = map.find(frozen::string(name));
         if(it == map.end()) 
             throw except::comtime_except("Unknown profile name in map (Forget to register ?)");
@@ -79,42 +237,82 @@ class StaticMapper {
             throw except::comtime_except("Name in map, points to the wrong profile");
     }
 
+    /*
+    Long option names sorted lexicographically,
+    lname_lcp[i] is the longest common prefix of entry i and i - 1,
+    which tells if a prefix match continues to the next entry
+    */
+    std::array<std::size_t, IDCount> sorted_lnames{};
+    std::array<WholeNumT, IDCount> lname_lcp{};
+    std::size_t lname_count = 0;
+
+    constexpr void sort_long_names() {
+        for(std::size_t i = 0; i < profiles.size(); i++) {
+            const profiles::static_profile& prof = profiles[i];
+            if(prof.is_posarg or !prof.lname) continue;
+            std::string_view name(prof.lname);
+            std::size_t pos = lname_count++;
+            while((pos > 0) && (name < std::string_view(profiles[sorted_lnames[pos - 1]].lname))) {
+                sorted_lnames[pos] = sorted_lnames[pos - 1];
+                --pos;
+            }
+            sorted_lnames[pos] = i;
+        }
+
+        for(std::size_t i = 1; i < lname_count; i++) {
+            std::string_view prev(profiles[sorted_lnames[i - 1]].lname);
+            std::string_view curr(profiles[sorted_lnames[i]].lname);
+            WholeNumT common = 0;
+            while((common < prev.size()) && (common < curr.size()) && (prev[common] == curr[common])) ++common;
+            lname_lcp[i] = common;
+        }
+    }
+
     template <std::size_t N>
-    constexpr auto get_ptable_posarg(const std::array<const profiles::static_profile*, N>& arr)
+    constexpr auto get_ptable_posarg(const std::array<std::size_t, N>& arr)
     {
         if constexpr  (N == 0) { 
-            return std::span<const profiles::static_profile* const>{};
+            return std::span<const std::size_t>{};
         } else {
-            return std::span<const profiles::static_profile* const>(arr);
+            return std::span<const std::size_t>(arr);
         }
     }
 
     public :
     const MapType map;
     const std::span<const profiles::static_profile> profiles;
-    const std::span<const profiles::static_profile* const> posargs;
+    const std::span<const profiles::hot_profile> hot;
+    const std::span<const std::size_t> posargs;
+    const std::span<const BitWord> required;
+    const GroupTable exclusions;
+    const GroupTable one_ofs;
 
     template <std::size_t ProfCount, std::size_t PosargCount>
     constexpr StaticMapper(
         const MapType& new_map,
         const ProfileTable<ProfCount, PosargCount>& ptable
-    ) : map(new_map), profiles(ptable.static_profiles), posargs(get_ptable_posarg(ptable.get_posargs()))
+    ) : map(new_map), profiles(ptable.static_profiles), hot(ptable.hot_profiles),
+        posargs(get_ptable_posarg(ptable.get_posargs())),
+        required(ptable.get_required()), exclusions(ptable.get_exclusions()), one_ofs(ptable.get_one_ofs())
     {
         std::size_t valid_mappings = 0;
-        for(const auto& prof : profiles) {
+        for(std::size_t i = 0; i < profiles.size(); i++) {
+            const profiles::static_profile& prof = profiles[i];
             if(prof.lname) {
-                verify_relation(&prof, prof.lname);
+                verify_relation(i, prof.lname);
                 ++valid_mappings;
             }
 
             if(prof.sname) {
-                verify_relation(&prof, prof.sname);
+                verify_relation(i, prof.sname);
                 ++valid_mappings;
             }
         }
 
         if(valid_mappings < IDCount)
             throw except::comtime_except("Unknown name was assigned to the map");
+
+        sort_long_names();
     }
 
     const profiles::static_profile* operator[](std::size_t idx) const noexcept {
@@ -122,88 +320,205 @@ class StaticMapper {
         return &profiles[idx];
     }
 
-    const profiles::static_profile* operator[](const PosargIndex& posarg_index) const noexcept {
-        if(posarg_index.val >= posargs.size()) return nullptr;
+    std::size_t operator[](const PosargIndex& posarg_index) const noexcept {
+        if(posarg_index.val >= posargs.size()) return npos_profile;
         return posargs[posarg_index.val];
     }
 
-    const profiles::static_profile* operator[](const std::string_view& name) const noexcept {
+    std::size_t operator[](const std::string_view& name) const noexcept {
         auto it = map.find(frozen::string(name));
-        if(it == map.end()) return nullptr;
+        if(it == map.end()) return npos_profile;
         return it->second;
     }
 
     std::size_t profile_index(const profiles::static_profile* target) const noexcept {
         return (target - &profiles[0]);
     }
+
+    constexpr AbbrevMatch abbreviated(const std::string_view& prefix) const noexcept {
+        return find_abbreviation(profiles, sorted_long_names(), std::span<const WholeNumT>(lname_lcp.data(), lname_count), prefix);
+    }
+
+    constexpr std::span<const std::size_t> sorted_long_names() const noexcept {
+        return std::span<const std::size_t>(sorted_lnames.data(), lname_count);
+    }
+
+    StaticView view() const noexcept {
+        return StaticView{
+            this,
+            [](const void* self, const std::string_view& name) -> std::size_t {
+                return (*static_cast<const StaticMapper*>(self))[name];
+            },
+            profiles, hot, posargs,
+            sorted_long_names(), std::span<const WholeNumT>(lname_lcp.data(), lname_count),
+            required, exclusions, one_ofs
+        };
+    }
 };
 
-using FindPair = std::pair<const profiles::static_profile*, profiles::modifiable_profile*>;
+// first is the cold static_profile, hot the packed record the parse core reads
+struct FindPair {
+    const profiles::static_profile* first = nullptr;
+    profiles::modifiable_profile* second = nullptr;
+    std::size_t index = 0;
+    const profiles::hot_profile* hot = nullptr;
+};
 
-template <std::size_t IDCount>
-class RuntimeMapper {
+/*
+Hot runtime state, kept apart from modifiable_profile
+so whole-context scans only touch packed words and counters.
+Storage is owned by the RuntimeContext, every span is indexed by profile index
+(called is indexed by bit)
+*/
+struct RuntimeState {
+    std::span<BitWord> called;
+    std::span<WholeNumT> call_count;
+    std::span<WholeNumT> fulfilled_args;
+    std::span<parser::StoreOp> stores; // resolved by RuntimeView::verify()
+
+    void mark_called(std::size_t idx) const noexcept { utils::bit_set(called, idx); }
+    bool is_called(std::size_t idx) const noexcept { return utils::bit_test(called, idx); }
+
+    void reset() const noexcept {
+        utils::bit_clear_all(called);
+        for(auto& n : call_count) n = 0;
+        for(auto& n : fulfilled_args) n = 0;
+    }
+};
+
+/*
+RuntimeView is everything the parse core touches at runtime,
+RuntimeMapper only adds the typed StaticMapper reference on top of it
+*/
+class RuntimeView {
     private :
+    StaticView static_view;
     std::span<profiles::modifiable_profile> mutable_profiles;
+    RuntimeState runtime_state;
     bool is_verified = false;
-    public :
-    const StaticMapper<IDCount>& mapper; // const reference in case mapper is compile-time evaluated object
 
-    RuntimeMapper(
-        const StaticMapper<IDCount>& new_mapper,
-        const std::span<profiles::modifiable_profile> new_mutable_profiles
-    ) : mutable_profiles(new_mutable_profiles), mapper(new_mapper) 
+    FindPair at(std::size_t idx) noexcept {
+        if(idx >= static_view.profiles.size()) return {};
+        return {&static_view.profiles[idx], &mutable_profiles[idx], idx, &static_view.hot[idx]};
+    }
+
+    void check_verified() const {
+        if(not is_verified) throw except::ParseError(except::Diagnostic{.kind = except::ErrorKind::NotInitialized});
+    }
+
+    public :
+    RuntimeView(
+        const StaticView& new_static_view,
+        const std::span<profiles::modifiable_profile> new_mutable_profiles,
+        const RuntimeState& new_state
+    ) : static_view(new_static_view), mutable_profiles(new_mutable_profiles), runtime_state(new_state)
     {}
 
     FindPair operator[](std::size_t idx) {
-        if(not is_verified) throw except::ParseError("RuntimeMapper is not initialized");
-        const profiles::static_profile* prof = mapper[idx];
-        if(!prof) return {nullptr, nullptr};
-        return {prof, &mutable_profiles[idx]};
+        check_verified();
+        return at(idx);
     }
 
     FindPair operator[](const PosargIndex& posarg_index) {
-        if(not is_verified) throw except::ParseError("RuntimeMapper is not initialized");
-        const profiles::static_profile* prof = mapper[posarg_index];
-        if(!prof) return {nullptr, nullptr};
-        return {prof, &mutable_profiles[mapper.profile_index(prof)]};
+        check_verified();
+        return at(static_view[posarg_index]);
     }
 
     FindPair operator[](const std::string_view& name) {
-        if(not is_verified) throw except::ParseError("RuntimeMapper is not initialized");
-        const profiles::static_profile* prof = mapper[name];
-        if(!prof) return {nullptr, nullptr};
-        return {prof, &mutable_profiles[mapper.profile_index(prof)]};
+        check_verified();
+        return at(static_view[name]);
+    }
+
+    FindPair abbreviated(const std::string_view& prefix, bool& ambiguous) {
+        check_verified();
+        AbbrevMatch match = static_view.abbreviated(prefix);
+        ambiguous = match.ambiguous;
+        return at(match.index);
+    }
+
+    FindPair bare_long(const std::string_view& bare) {
+        check_verified();
+        return at(static_view.bare_long(bare));
     }
 
     std::size_t existing_profile() const noexcept {
-        return mapper.profiles.size();
+        return static_view.profiles.size();
     }
 
     std::size_t existing_posarg() const noexcept {
-        return mapper.posargs.size();
+        return static_view.posargs.size();
+    }
+
+    // back to the state right after verify(), sinks trackers included
+    void reset() {
+        runtime_state.reset();
+        for(auto& mprof : mutable_profiles) mprof.bval.reset();
     }
 
+    // reset() and every bound value set back to T{}, nothing of the last parse stays readable
+    void clear() {
+        runtime_state.reset();
+        for(auto& mprof : mutable_profiles) mprof.bval.clear();
+    }
+
+    const StaticView& statics() const noexcept { return static_view; }
+    const RuntimeState& state() const noexcept { return runtime_state; }
+
+    bool is_called(std::size_t idx) const noexcept { return runtime_state.is_called(idx); }
+    WholeNumT call_count(std::size_t idx) const noexcept { return runtime_state.call_count[idx]; }
+    WholeNumT fulfilled_args(std::size_t idx) const noexcept { return runtime_state.fulfilled_args[idx]; }
+
+    // checks every sink against its profile and resolves the StoreOps, run it again after rebinding a sink
     void verify() {
-        if(mutable_profiles.size() != mapper.profiles.size())
+        if(mutable_profiles.size() != static_view.profiles.size())
             throw std::invalid_argument("mutable profile size doesn't match mapper profile size");
-        std::size_t lim = mapper.profiles.size();
+        if(
+            (runtime_state.call_count.size() != static_view.profiles.size())
+            or (runtime_state.fulfilled_args.size() != static_view.profiles.size())
+            or (runtime_state.called.size() != utils::bit_words(static_view.profiles.size()))
+            or (runtime_state.stores.size() != static_view.profiles.size())
+        )
+            throw std::invalid_argument("runtime state size doesn't match mapper profile size");
+        std::size_t lim = static_view.profiles.size();
         for(std::size_t i = 0; i < lim; i++) {
-            const profiles::static_profile& sprof = *mapper[i];
+            const profiles::static_profile& sprof = *static_view[i];
             profiles::modifiable_profile& mprof = mutable_profiles[i];
 
             if(values::is_ref_ctgry(mprof.bval.get_code())) {
-                if(mprof.bval.get_code() != sprof.convert_code)
+                if(mprof.bval.get_code() != values::type_code::sink_code(sprof.convert_code))
                     throw std::invalid_argument("BoundValue variable reference type is incompatible with static_profile convert code");
                 
                 if(sprof.narg > 1)
                     throw std::invalid_argument("static_profile narg more than 1 is incompatible with variable reference BoundValue");
+
+                if(sprof.delimiter)
+                    throw std::invalid_argument("static_profile with a delimiter needs an array BoundValue");
             } else {
+                bool custom_prof = (sprof.convert_code == values::type_code::kCustom);
+                bool custom_sink = (mprof.bval.get_code() == values::type_code::kCustom);
+                if((custom_prof != custom_sink)
+                    or (custom_prof and (mprof.bval.custom_type() != sprof.converter->value_type)))
+                    throw std::invalid_argument("BoundValue custom sink is incompatible with the converter of static_profile");
                 if(mprof.bval.consume_amnt() < sprof.narg)
                     throw std::invalid_argument("BoundValue array size is less than static_profile narg");
             }
+            runtime_state.stores[i] = parser::resolve_store(mprof.bval, sprof);
         }
         is_verified = true;
     }
 };
+
+template <std::size_t IDCount>
+class RuntimeMapper : public RuntimeView {
+    public :
+    const StaticMapper<IDCount>& mapper; // const reference in case mapper is compile-time evaluated object
+
+    RuntimeMapper(
+        const StaticMapper<IDCount>& new_mapper,
+        const std::span<profiles::modifiable_profile> new_mutable_profiles,
+        const RuntimeState& new_state
+    ) : RuntimeView(new_mapper.view(), new_mutable_profiles, new_state), mapper(new_mapper)
+    {}
+};
 }
 }
\ No newline at end of file
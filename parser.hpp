@@ -3,10 +3,16 @@
 #include <string_view>
 #include <cctype>
 #include <charconv>
+#include <cstring>
+#include <array>
+#include <span>
+#include "convert.hpp"
+#include "executor.hpp"
 #include "mapper.hpp"
 #include "profiles.hpp"
 #include "exceptions.hpp"
 #include "values.hpp"
+#include "utils.hpp"
 
 namespace sp {
 
@@ -14,92 +20,78 @@ namespace parser {
 
 using namespace sp;
 
-bool potential_digit(const char* str) {
-    int start = 0;
-    if((str[0] == '-') or (str[0] == '+')) ++start;
-    return std::isdigit(str[start]);
-}
+inline constexpr FlagType kAllowAbbrev = 1 << 0; // resolve unique prefixes of long option names
+
+/*
+Token sources of the parse core,
+both argv and the dump are arrays of null-terminated tokens,
+so a single non-template cursor walks either of them
+*/
+struct TokenCursor {
+    const char* const* tokens = nullptr;
+    std::size_t count = 0;
+    std::size_t pos = 0;
 
-void from_chars_result_check(const std::from_chars_result& res, std::string_view input) {
-    if(res.ec == std::errc::invalid_argument) 
-        throw except::ParseError(std::string("Input : ").append(input) + ", Is not a number");
-    
-    if(res.ec == std::errc::result_out_of_range) {
-        throw except::ParseError(std::string("Input : ").append(input) + ", Is out of range"); 
+    std::string_view operator()() noexcept {
+        if(pos == count) return std::string_view{};
+        return std::string_view(tokens[pos++]);
     }
+};
 
-    if(res.ptr < (input.data() + input.size()))
-        throw except::ParseError(std::string("Can't fully convert").append(input) + " To a number");
-}
-
-template <typename FillF>
-bool convert_and_insert(const FillF& fill, std::string_view input, values::type_code::Tcode code) {
-    if(input.empty())
-        throw except::ParseError("convert-insert operation failed, input token is empty");
-    
-    switch(code.value()) {
-        case kCodeDob.value() :
-            {
-                DobT buff = 0;
-                from_chars_result_check(
-                    std::from_chars(input.data(), input.data() + input.size(), buff),
-                    input
-                );
-                return fill(buff);
-            }
-            break;
-
-        case kCodeInt.value() :
-            {
-                IntT buff = 0;
-                from_chars_result_check(
-                    std::from_chars(input.data(), input.data() + input.size(), buff),
-                    input
-                );
-                return fill(buff);
-            }
-            break;
-
-        case kCodeStr.value() : 
-        {
-            if(input[input.size()] != '\0')
-                throw except::ParseError(std::string("Token : ").append(input) + " Is not null-terminated");
-            return fill(input.data());
-        }
-            break;
+struct DumpBuffer {
+    std::span<const char*> slots;
+    std::size_t used = 0;
 
-        default :
-            throw except::ParseError(std::string("Unknown type code of ") + values::type_code::code_to_str(code));
-        
+    void operator()(const std::string_view& token) {
+        if(used == slots.size())
+            throw except::ParseError(except::Diagnostic{
+                .kind = except::ErrorKind::DumpOverflow,
+                .amount = static_cast<std::int64_t>(slots.size()),
+                .token = token
+            });
+        slots[used++] = token.data();
     }
+
+    TokenCursor cursor() const noexcept { return TokenCursor{slots.data(), used}; }
+};
+
+inline bool potential_digit(const char* str) noexcept {
+    int start = 0;
+    if((str[0] == '-') or (str[0] == '+')) ++start;
+    return std::isdigit(str[start]);
 }
 
-template <typename ArgGetF>
-std::string_view fetch_and_next(
+inline std::string_view fetch_and_next(
     mapper::FindPair& complete_prof,
-    const ArgGetF& get,
+    const mapper::RuntimeState& state,
+    TokenCursor& get,
     const std::string_view& eq_value,
     bool (*check_token)(const std::string_view&) = [](const std::string_view& _){ return false; }
 )
 {
-    const profiles::static_profile& static_prof = *complete_prof.first;
-    profiles::modifiable_profile& mod_prof = *complete_prof.second;
-    std::size_t to_parse = static_prof.narg - mod_prof.fulfilled_args;
+    const profiles::static_profile& static_prof = *complete_prof.first; // cold, only handed to the store
+    const profiles::hot_profile& hot = *complete_prof.hot;
+    const StoreOp& store = state.stores[complete_prof.index];
+    WholeNumT& fulfilled_args = state.fulfilled_args[complete_prof.index];
+    std::size_t to_parse = hot.narg - fulfilled_args;
     std::string_view curr_token;
-    auto fill = mod_prof.bval.opc();
-    
-    if(((signed)to_parse <= 0) && (profiles::is_restricted(static_prof.behave))){
-        mod_prof.is_called = true;
+    store.reset(store.sink);
+    // profile_name is left to name_profile, once the error leaves the parse core
+    const except::Diagnostic where{.profile_index = static_cast<std::int32_t>(complete_prof.index)};
+
+    ++state.call_count[complete_prof.index];
+    if(((signed)to_parse <= 0) && (profiles::is_restricted(hot.behave))){
+        state.mark_called(complete_prof.index);
         return get();
     }
 
     if(!eq_value.empty()) {
-        if(convert_and_insert(fill, eq_value, static_prof.convert_code)) --to_parse;
+        if(store(eq_value, static_prof, where)) --to_parse;
         curr_token = get();
         
     } else {
         curr_token = get();
-        bool ins_res;
+        bool ins_res = false; // stays false when nothing is left to fetch
         bool stop_token_criteria_are_met = false;
 
         long_fetch :
@@ -108,7 +100,7 @@ std::string_view fetch_and_next(
             if(curr_token.empty()) break;
             if((stop_token_criteria_are_met = check_token(curr_token))) break;
             if(
-                !(ins_res = convert_and_insert(fill, curr_token, static_prof.convert_code))
+                !(ins_res = store(curr_token, static_prof, where))
             ) break;
             curr_token = get();
             --to_parse;
@@ -118,7 +110,7 @@ std::string_view fetch_and_next(
             !ins_res 
             or (
                 !to_parse 
-                and profiles::is_restricted(static_prof.behave)) 
+                and profiles::is_restricted(hot.behave)) 
             or curr_token.empty()
             or stop_token_criteria_are_met) {}
         else {
@@ -127,21 +119,72 @@ std::string_view fetch_and_next(
         }
     }
 
+    if((signed)to_parse > 0) {
+        except::Diagnostic diag = where;
+        diag.kind = except::ErrorKind::InsufficientNarg;
+        diag.amount = static_cast<std::int64_t>(to_parse);
+        diag.token = curr_token;
+        throw except::ParseError(diag);
+    }
+    state.mark_called(complete_prof.index);
+    fulfilled_args += hot.narg - (to_parse + fulfilled_args);
+    return curr_token;
+}
+
+/*
+fetch_and_next of a posarg whose store takes whole runs of tokens,
+consumes the same tokens and reports the same errors, but the tokens
+are handed to the sink in a single call instead of one store each
+*/
+inline std::string_view fetch_run(
+    mapper::FindPair& complete_prof,
+    const mapper::RuntimeState& state,
+    TokenCursor& get
+)
+{
+    const profiles::hot_profile& hot = *complete_prof.hot;
+    const StoreOp& store = state.stores[complete_prof.index];
+    WholeNumT& fulfilled_args = state.fulfilled_args[complete_prof.index];
+    std::size_t to_parse = hot.narg - fulfilled_args;
+    const bool restricted = profiles::is_restricted(hot.behave);
+    store.reset(store.sink);
+
+    ++state.call_count[complete_prof.index];
+    if((((signed)to_parse <= 0) && restricted) or !to_parse) {
+        state.mark_called(complete_prof.index);
+        return get();
+    }
+
+    // a run ends on an empty token, on the input end, or after to_parse tokens when restricted
+    std::size_t limit = get.count - get.pos;
+    if(restricted && (to_parse < limit)) limit = to_parse;
+    std::size_t run = 0;
+    while((run < limit) && (get.tokens[get.pos + run][0] != '\0')) ++run;
+
+    std::size_t stored = store.bulk(store.sink, std::span<const StrT>(get.tokens + get.pos, run));
+    get.pos += stored;
+    // wraps past narg, with the same extra step as the greedy fetch of fetch_and_next
+    if(!restricted && (stored >= to_parse) && (run > to_parse)) --to_parse;
+    to_parse -= stored;
+    std::string_view curr_token = get(); // the rejected token when the sink is full
+
     if((signed)to_parse > 0)
-        throw except::ParseError(
-            std::string("Insufficient narg for ") + get_name(static_prof)
-            + ", still needs " + std::to_string(to_parse)
-        );
-    mod_prof.is_called = true;
-    mod_prof.fulfilled_args += static_prof.narg - (to_parse + mod_prof.fulfilled_args);
+        throw except::ParseError(except::Diagnostic{
+            .kind = except::ErrorKind::InsufficientNarg,
+            .profile_index = static_cast<std::int32_t>(complete_prof.index),
+            .amount = static_cast<std::int64_t>(to_parse),
+            .token = curr_token
+        });
+    state.mark_called(complete_prof.index);
+    fulfilled_args += hot.narg - (to_parse + fulfilled_args);
     return curr_token;
 }
 
-template <typename ArgGetF, typename DumpStoreF, std::size_t IDCount>
-void handle_opt(
-    mapper::RuntimeMapper<IDCount>& rmap,
-    const ArgGetF& get, 
-    const DumpStoreF& store
+inline void handle_opt(
+    mapper::RuntimeView& rmap,
+    TokenCursor& get,
+    DumpBuffer& store,
+    FlagType parse_flags = 0
 ) {
     std::string_view curr_token = get();
     std::string_view eq_value{};
@@ -160,90 +203,248 @@ void handle_opt(
         }
 
         mapper::FindPair complete_prof = rmap[curr_token];
+        // "--" alone is a marker, not a prefix of every long name
+        if(!complete_prof.first and (parse_flags & kAllowAbbrev) and (curr_token.size() > 2) and curr_token.starts_with("--")) {
+            bool ambiguous = false;
+            complete_prof = rmap.abbreviated(curr_token, ambiguous);
+            if(ambiguous)
+                throw except::ParseError(except::Diagnostic{.kind = except::ErrorKind::AmbiguousFlag, .token = curr_token});
+        }
         if(!complete_prof.first or !complete_prof.second)
-            throw except::ParseError(std::string("Unknown flag was passed : ").append(curr_token));
+            throw except::ParseError(except::Diagnostic{.kind = except::ErrorKind::UnknownFlag, .token = curr_token});
         
+        if(complete_prof.hot->call_limit && (rmap.state().call_count[complete_prof.index] >= complete_prof.hot->call_limit))
+            throw except::ParseError(except::Diagnostic{
+                .kind = except::ErrorKind::CallLimit,
+                .profile_index = static_cast<std::int32_t>(complete_prof.index),
+                .amount = static_cast<std::int64_t>(complete_prof.hot->call_limit),
+                .token = curr_token
+            });
+
         curr_token = fetch_and_next(
-            complete_prof, get, eq_value,
+            complete_prof, rmap.state(), get, eq_value,
             [](const std::string_view& token){ return (token[0] == '-'); }
         );
-        if(profiles::is_immediate(complete_prof.first->behave))
+        if(profiles::is_immediate(complete_prof.hot->behave))
             complete_prof.second->callback(*complete_prof.first, *complete_prof.second);
         if(!eq_value.empty())
             eq_value = std::string_view{};
     }
 }
 
-template <typename DumpGetF, std::size_t IDCount>
-void handle_posarg(const DumpGetF& dump_get, mapper::RuntimeMapper<IDCount>& rmap) {
-    std::size_t curr_posarg_order = 0;
-    std::string_view curr_token{};
-    mapper::FindPair complete_prof;
+/*
+Posarg distribution of total positional tokens, shared with the completion :
+every posarg takes its narg, the leftmost unrestricted one also takes the leftover,
+so `SRC... DST` is Posarg()("src").nargs(1) then Posarg()("dst").nargs(1).restricted().
+visit(order, share) returns false to stop, shares aren't clamped to total
+*/
+template <typename Visit>
+constexpr void split_posargs(const mapper::StaticView& statics, std::size_t total, Visit&& visit) {
+    const std::size_t posarg_count = statics.posargs.size();
+    std::size_t min_total = 0;
+    for(std::size_t order = 0; order < posarg_count; order++)
+        min_total += statics.hot[statics[mapper::PosargIndex(order)]].narg;
+    std::size_t extra = (total > min_total) ? (total - min_total) : 0;
 
-    while(curr_posarg_order < rmap.existing_posarg()) {
-        complete_prof = rmap[mapper::PosargIndex(curr_posarg_order)];
-        curr_token = fetch_and_next(complete_prof, dump_get, std::string_view{});
-        if(curr_token.empty()) break;
+    for(std::size_t order = 0; order < posarg_count; order++) {
+        const profiles::hot_profile& hot = statics.hot[statics[mapper::PosargIndex(order)]];
+        std::size_t share = hot.narg;
+        if(!profiles::is_restricted(hot.behave)) {
+            share += extra;
+            extra = 0;
+        }
+        if(!visit(order, share)) return;
     }
+}
 
-    if(!curr_token.empty())
-        throw except::ParseError(std::string("Unexpected dump inputs of ").append(curr_token));
+// each posarg is fetched from its own slice of the dump
+inline void handle_posarg(TokenCursor& dump_get, mapper::RuntimeView& rmap) {
+    if(!rmap.existing_posarg()) return;
+
+    bool ended = false;
+    split_posargs(rmap.statics(), dump_get.count - dump_get.pos, [&](std::size_t order, std::size_t share) {
+        mapper::FindPair complete_prof = rmap[mapper::PosargIndex(order)];
+        std::size_t left = dump_get.count - dump_get.pos;
+        if(share > left) share = left;
+
+        TokenCursor slice{dump_get.tokens + dump_get.pos, share};
+        dump_get.pos += share;
+        std::string_view curr_token = rmap.state().stores[complete_prof.index].bulk
+            ? fetch_run(complete_prof, rmap.state(), slice)
+            : fetch_and_next(complete_prof, rmap.state(), slice, std::string_view{});
+        // an empty token ends the posargs, a token left in the slice didn't fit the sink
+        if(curr_token.empty() && (slice.pos < slice.count)) {
+            ended = true;
+            return false;
+        }
+        if(!curr_token.empty())
+            throw except::ParseError(except::Diagnostic{.kind = except::ErrorKind::UnexpectedInput, .token = curr_token});
+        return true;
+    });
+
+    if(!ended && (dump_get.pos < dump_get.count))
+        throw except::ParseError(except::Diagnostic{.kind = except::ErrorKind::UnexpectedInput, .token = dump_get()});
 }
 
-template<std::size_t N>
-struct DumpSize {};
+inline void check_required(mapper::RuntimeView& rmap) {
+    std::size_t missing = utils::first_and_not(rmap.statics().required, rmap.state().called);
+    if(missing != utils::npos_bit) {
+        mapper::FindPair complete_prof = rmap[missing];
+        throw except::ParseError(except::Diagnostic{
+            .kind = except::ErrorKind::MissingRequired,
+            .profile_index = static_cast<std::int32_t>(missing),
+            .profile_name = profiles::get_name(*complete_prof.first),
+            .other_name = (complete_prof.first->is_posarg ? "posarg" : "option")
+        });
+    }
+}
 
-template <std::size_t IDCount, std::size_t dump_size>
-void parse(
-    mapper::RuntimeMapper<IDCount>& rmap,
-    const char** argv,
-    int argc,
-    DumpSize<dump_size>
-) {
-    std::array<std::string_view, dump_size> dump{};
-    std::size_t dump_i = 0;
-    std::size_t arg_i = 0;
-    std::size_t dump_get_i = 0;
-    auto arg_get = [&](){
-        if(arg_i == argc) return std::string_view{};
-        return std::string_view(argv[arg_i++]);
-    };
-
-    auto dump_store = [&](const std::string_view& token) -> void {
-        if(dump_i == dump_size)
-            throw except::ParseError("Dump inputs exceed dump size");
-        
-        dump[dump_i++] = token;
-    };
+inline void check_constraints(mapper::RuntimeView& rmap) {
+    std::span<const BitWord> called = rmap.state().called;
+    const mapper::StaticView& statics = rmap.statics();
+    const mapper::GroupTable& exclusions = statics.exclusions;
+    const mapper::GroupTable& one_ofs = statics.one_ofs;
 
-    auto dump_get = [&]() {
-        if(dump_get_i == dump_i) return std::string_view{};
-        
-        return dump[dump_get_i++];
-    };
+    for(std::size_t g = 0; g < exclusions.count(); g++) {
+        if(utils::popcount_and(exclusions[g], called) > 1) {
+            std::size_t first = utils::nth_and(exclusions[g], called, 0);
+            throw except::ParseError(except::Diagnostic{
+                .kind = except::ErrorKind::MutuallyExclusive,
+                .profile_index = static_cast<std::int32_t>(first),
+                .profile_name = profiles::get_name(*statics[first]),
+                .other_name = profiles::get_name(*statics[utils::nth_and(exclusions[g], called, 1)])
+            });
+        }
+    }
+
+    for(std::size_t g = 0; g < one_ofs.count(); g++) {
+        if(!utils::any_and(one_ofs[g], called)) {
+            std::size_t first = utils::nth_and(one_ofs[g], one_ofs[g], 0);
+            throw except::ParseError(except::Diagnostic{
+                .kind = except::ErrorKind::OneOfMissing,
+                .profile_index = static_cast<std::int32_t>(first),
+                .amount = one_ofs.ids[g],
+                .profile_name = profiles::get_name(*statics[first])
+            });
+        }
+    }
+}
+
+inline void run_callbacks(mapper::RuntimeView& rmap) {
+    utils::for_each_bit(rmap.state().called, [&](std::size_t i) {
+        mapper::FindPair complete_prof = rmap[i];
+        complete_prof.second->callback(*complete_prof.first, *complete_prof.second);
+    });
+}
 
-    handle_opt(rmap, arg_get, dump_store);
-    handle_posarg(dump_get, rmap);
+// independent callbacks go to exec, the others run in-line as above
+inline CallbackJoin run_callbacks(mapper::RuntimeView& rmap, const Executor& exec) {
+    CallbackJoin handle;
+    detail::JoinState& join = handle.shared();
 
-    for(std::size_t i{0}; i < rmap.existing_profile(); i++) {
+    utils::for_each_bit(rmap.state().called, [&](std::size_t i) {
         mapper::FindPair complete_prof = rmap[i];
-        if(profiles::is_required(complete_prof.first->behave) and not (complete_prof.second->is_called)) {
-            throw except::ParseError(
-                (((std::string("A required ")
-                + (complete_prof.first->is_posarg ? "posarg" : "option")    
-                ) + " of \""
-                ) + profiles::get_name(*complete_prof.first)
-                ) + "\" was not called"
-            );
+        if(!profiles::is_independent(complete_prof.hot->behave)) return;
+        join.pending.fetch_add(1, std::memory_order_relaxed);
+        try {
+            exec.submit(CallbackTask{complete_prof.first, complete_prof.second, &join});
+        } catch(...) {
+            join.done(); // the task was never queued, the others are joined by the handle
+            throw;
         }
-    }
+    });
 
-    for(std::size_t i{0}; i < rmap.existing_profile(); i++) {
+    utils::for_each_bit(rmap.state().called, [&](std::size_t i) {
         mapper::FindPair complete_prof = rmap[i];
-        
-        if(complete_prof.second->is_called) 
+        if(!profiles::is_independent(complete_prof.hot->behave))
             complete_prof.second->callback(*complete_prof.first, *complete_prof.second);
+    });
+    return handle;
+}
+
+// fills argv_index / offset of diag when its token points inside one of the args
+inline void locate(except::Diagnostic& diag, const TokenCursor& args) noexcept {
+    const char* at = diag.token.data();
+    if(!at or (diag.argv_index >= 0)) return;
+    for(std::size_t i = 0; i < args.count; i++) {
+        const char* arg = args.tokens[i];
+        if((at >= arg) && (at <= (arg + std::strlen(arg)))) {
+            diag.argv_index = static_cast<std::int32_t>(i);
+            diag.offset = static_cast<std::uint32_t>(at - arg);
+            return;
+        }
+    }
+}
+
+// fills profile_name of diag from its profile_index, the parse core only records the index
+inline void name_profile(except::Diagnostic& diag, const mapper::StaticView& statics) noexcept {
+    if(diag.profile_name or (diag.profile_index < 0)) return;
+    if(const profiles::static_profile* prof = statics[static_cast<std::size_t>(diag.profile_index)])
+        diag.profile_name = get_name(*prof);
+}
+
+// parse and validation, without the post-parse callbacks
+inline void parse_values(
+    mapper::RuntimeView& rmap,
+    TokenCursor args,
+    std::span<const char*> dump_slots,
+    FlagType parse_flags = 0
+) {
+    DumpBuffer dump{dump_slots};
+
+    try {
+        handle_opt(rmap, args, dump, parse_flags);
+        TokenCursor dump_get = dump.cursor();
+        handle_posarg(dump_get, rmap);
+    } catch(except::ParseError& err) {
+        locate(err.diagnostic(), args);
+        name_profile(err.diagnostic(), rmap.statics());
+        throw;
     }
+
+    check_required(rmap);
+    check_constraints(rmap);
+}
+
+// non-template parse core, every RuntimeMapper<IDCount> / DumpSize<N> shares it
+inline void parse_core(
+    mapper::RuntimeView& rmap,
+    TokenCursor args,
+    std::span<const char*> dump_slots,
+    FlagType parse_flags = 0
+) {
+    parse_values(rmap, args, dump_slots, parse_flags);
+    run_callbacks(rmap);
+}
+
+template<std::size_t N>
+struct DumpSize {};
+
+template <std::size_t IDCount, std::size_t dump_size>
+void parse(
+    mapper::RuntimeMapper<IDCount>& rmap,
+    const char** argv,
+    int argc,
+    DumpSize<dump_size>,
+    FlagType parse_flags = 0
+) {
+    std::array<const char*, dump_size> dump{};
+    parse_core(rmap, TokenCursor{argv, static_cast<std::size_t>(argc)}, dump, parse_flags);
+}
+
+// independent callbacks are submitted to exec, the returned handle joins them
+template <std::size_t IDCount, std::size_t dump_size>
+[[nodiscard]] CallbackJoin parse(
+    mapper::RuntimeMapper<IDCount>& rmap,
+    const char** argv,
+    int argc,
+    DumpSize<dump_size>,
+    const Executor& exec,
+    FlagType parse_flags = 0
+) {
+    std::array<const char*, dump_size> dump{};
+    parse_values(rmap, TokenCursor{argv, static_cast<std::size_t>(argc)}, dump, parse_flags);
+    return run_callbacks(rmap, exec);
 }
 
 }
@@ -0,0 +1,187 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "commons.hpp"
+#include "exceptions.hpp"
+
+namespace sp {
+
+namespace pool {
+
+/*
+Pool of pre-built, pre-verified runtime contexts
+
+Every context is built up front by the factory (so RuntimeContext
+verification happens once), handed out through a PooledContext
+RAII handle and clear()ed when the handle goes away : the call state
+is reset and every bound sink is set back to T{}, so the values of one
+request never reach the next. Defaults set by the factory don't survive
+the first release, apply them after acquire().
+
+Free contexts live in a small per-thread cache first and overflow
+into a lock-free global free-list (Treiber stack over slot indices,
+the head carries a tag against ABA). When both are empty the factory
+builds an extra context owned by the handle alone.
+
+Context must provide clear(), handles must not outlive their pool.
+*/
+
+template <typename Context, std::size_t LocalSlots = 4>
+class ContextPool;
+
+template <typename Context, std::size_t LocalSlots>
+class PooledContext {
+    private :
+    using PoolType = ContextPool<Context, LocalSlots>;
+    using CoreType = typename PoolType::Core;
+
+    CoreType* core = nullptr;
+    Context* ctx = nullptr;
+    std::uint32_t slot = CoreType::npos; // npos for overflow contexts
+
+    friend PoolType;
+
+    PooledContext(CoreType* new_core, Context* new_ctx, std::uint32_t new_slot) noexcept
+        : core(new_core), ctx(new_ctx), slot(new_slot) {}
+
+    public :
+    PooledContext(const PooledContext&) = delete;
+    PooledContext& operator=(const PooledContext&) = delete;
+
+    PooledContext(PooledContext&& oth) noexcept
+        : core(std::exchange(oth.core, nullptr)), ctx(std::exchange(oth.ctx, nullptr)), slot(oth.slot) {}
+
+    PooledContext& operator=(PooledContext&& oth) noexcept {
+        if(this != &oth) {
+            release();
+            core = std::exchange(oth.core, nullptr);
+            ctx = std::exchange(oth.ctx, nullptr);
+            slot = oth.slot;
+        }
+        return *this;
+    }
+
+    ~PooledContext() { release(); }
+
+    void release() noexcept {
+        if(!ctx) return;
+        if(slot == CoreType::npos) delete ctx;
+        else PoolType::give_back(core, slot);
+        ctx = nullptr;
+    }
+
+    Context& operator*() const noexcept { return *ctx; }
+    Context* operator->() const noexcept { return ctx; }
+    Context* get() const noexcept { return ctx; }
+};
+
+template <typename Context, std::size_t LocalSlots>
+class ContextPool {
+    private :
+    struct Core : public std::enable_shared_from_this<Core> {
+        static constexpr std::uint32_t npos = static_cast<std::uint32_t>(-1);
+
+        std::vector<std::unique_ptr<Context>> contexts;
+        std::unique_ptr<std::atomic<std::uint32_t>[]> next;
+        std::atomic<std::uint64_t> head{npos}; // high 32 bits : tag, low 32 bits : slot
+        std::function<Context*()> make;
+
+        void push(std::uint32_t slot) noexcept {
+            std::uint64_t old = head.load(std::memory_order_relaxed);
+            std::uint64_t desired = 0;
+            do {
+                next[slot].store(static_cast<std::uint32_t>(old), std::memory_order_relaxed);
+                desired = ((((old >> 32) + 1) << 32) | slot);
+            } while(!head.compare_exchange_weak(old, desired, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        std::uint32_t pop() noexcept {
+            std::uint64_t old = head.load(std::memory_order_acquire);
+            while(true) {
+                std::uint32_t slot = static_cast<std::uint32_t>(old);
+                if(slot == npos) return npos;
+                std::uint32_t following = next[slot].load(std::memory_order_relaxed);
+                std::uint64_t desired = ((((old >> 32) + 1) << 32) | following);
+                if(head.compare_exchange_weak(old, desired, std::memory_order_acquire, std::memory_order_acquire))
+                    return slot;
+            }
+        }
+    };
+
+    // per-thread cache, keeps its owner alive until the thread gives the slots back
+    struct LocalCache {
+        std::shared_ptr<Core> owner;
+        std::array<std::uint32_t, LocalSlots> slots{};
+        std::size_t size = 0;
+
+        ~LocalCache() {
+            while(size) owner->push(slots[--size]);
+        }
+    };
+
+    std::shared_ptr<Core> core;
+
+    static LocalCache& local() noexcept {
+        thread_local LocalCache cache;
+        return cache;
+    }
+
+    static void give_back(Core* owner, std::uint32_t slot) noexcept {
+        owner->contexts[slot]->clear();
+
+        LocalCache& cache = local();
+        if((cache.owner.get() != owner) && !cache.size)
+            cache.owner = owner->shared_from_this();
+
+        if((cache.owner.get() == owner) && (cache.size < LocalSlots))
+            cache.slots[cache.size++] = slot;
+        else
+            owner->push(slot);
+    }
+
+    friend PooledContext<Context, LocalSlots>;
+
+    public :
+
+    template <typename Factory>
+    ContextPool(std::size_t capacity, Factory factory) : core(std::make_shared<Core>()) {
+        if(capacity >= Core::npos)
+            throw except::SetupError("ContextPool capacity is too large");
+
+        core->make = [factory]() { return new Context(factory()); };
+        core->contexts.reserve(capacity);
+        core->next = std::make_unique<std::atomic<std::uint32_t>[]>(capacity);
+        for(std::size_t i = 0; i < capacity; i++) {
+            core->contexts.emplace_back(core->make());
+            core->push(static_cast<std::uint32_t>(i));
+        }
+    }
+
+    ContextPool(const ContextPool&) = delete;
+    ContextPool& operator=(const ContextPool&) = delete;
+
+    PooledContext<Context, LocalSlots> acquire() {
+        LocalCache& cache = local();
+        std::uint32_t slot = Core::npos;
+
+        if((cache.owner == core) && cache.size)
+            slot = cache.slots[--cache.size];
+        else
+            slot = core->pop();
+
+        if(slot == Core::npos)
+            return PooledContext<Context, LocalSlots>(core.get(), core->make(), Core::npos);
+        return PooledContext<Context, LocalSlots>(core.get(), core->contexts[slot].get(), slot);
+    }
+
+    std::size_t capacity() const noexcept { return core->contexts.size(); }
+};
+
+}
+}
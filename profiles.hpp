@@ -13,13 +13,15 @@ namespace profiles{
 
 using namespace sp;
 
-static constexpr FlagType kRequired = 1 << 0;
-static constexpr FlagType kRestricted = 1 << 1;
-static constexpr FlagType kImmediate = 1 << 2;
+inline constexpr FlagType kRequired = 1 << 0;
+inline constexpr FlagType kRestricted = 1 << 1;
+inline constexpr FlagType kImmediate = 1 << 2;
+inline constexpr FlagType kIndependent = 1 << 3;
 
 constexpr bool is_required(FlagType flag) { return ((flag & kRequired) != 0); }
 constexpr bool is_restricted(FlagType flag) { return ((flag & kRestricted) != 0); }
 constexpr bool is_immediate(FlagType flag) { return ((flag & kImmediate) != 0); }
+constexpr bool is_independent(FlagType flag) { return ((flag & kIndependent) != 0); }
 
 struct static_profile;
 
@@ -29,11 +31,15 @@ struct ConstructingProfile {
     NameType sname = nullptr;
     NameType desc = "No Desc";
     WholeNumT narg = 0;
-    NumT positional_order = 0; 
+    NumT positional_order = -1; // declaration order unless order() is set
     NumT exclude_point = -1;
-    WholeNumT call_limit = 1;
+    NumT group_point = -1;
+    WholeNumT call_limit = 0; // 0 = unlimited, only call_lim() sets a limit
     FlagType behave = 0;
     TypeCodeT convert_code = 0;
+    const values::ChoiceTable* choice_table = nullptr;
+    const values::Converter* converter = nullptr;
+    char delim = '\0';
     bool posarg = false;
 
     constexpr void verify() const {
@@ -49,6 +55,8 @@ struct ConstructingProfile {
                 throw except::comtime_except("Empty narg are forbidden on posarg");
             if(exclude_point >= 0)
                 throw except::comtime_except("Posarg shouldn't have an exclusion point");
+            if(group_point >= 0)
+                throw except::comtime_except("Posarg shouldn't have a group point");
             if(not utils::valid_posarg_name(lname))
                 throw except::comtime_except("Invalid posarg name format");
         } else {
@@ -67,8 +75,20 @@ struct ConstructingProfile {
         if(values::is_arr_ctgry(convert_code))
             throw except::comtime_except("Typecode ARRAY doesn't specify any type to convert");
 
-        if(!call_limit)
-            throw except::comtime_except("Call limit of 0 are forbidden");
+        if((convert_code == kCodeChoice) != (choice_table != nullptr))
+            throw except::comtime_except("kCodeChoice requires a choice set, declare it with choices<...>()");
+
+        if((convert_code == kCodeCustom) != (converter != nullptr))
+            throw except::comtime_except("kCodeCustom requires a converter, declare it with convert_with(&converter)");
+
+        if(delim and (convert_code.none() or (convert_code == kCodeStr)))
+            throw except::comtime_except("A delimiter needs a numeric, choice or custom convert code (string elements can't be null-terminated)");
+
+        if(call_limit > 0xFFFF)
+            throw except::comtime_except("Call limit above 65535 is not supported");
+
+        if(is_immediate(behave) and is_independent(behave))
+            throw except::comtime_except("An immediate callback can't be independent");
 
     }
 
@@ -92,6 +112,23 @@ struct ConstructingProfile {
         return *this;
     }
 
+    constexpr ConstructingProfile& choose_from(const values::ChoiceTable* table) {
+        convert_code = kCodeChoice;
+        choice_table = table;
+        return *this;
+    }
+
+    constexpr ConstructingProfile& convert_by(const values::Converter* conv) {
+        convert_code = kCodeCustom;
+        converter = conv;
+        return *this;
+    }
+
+    constexpr ConstructingProfile& split_on(char new_delim) {
+        delim = new_delim;
+        return *this;
+    }
+
     constexpr ConstructingProfile& set_nargs(WholeNumT new_narg) {
         narg = new_narg;
         return *this;
@@ -117,6 +154,11 @@ struct ConstructingProfile {
         return *this;
     }
 
+    constexpr ConstructingProfile& group_on(NumT pos) {
+        group_point = pos;
+        return *this;
+    }
+
     constexpr ConstructingProfile& description(NameType des) {
         desc = des;
         return *this;
@@ -161,6 +203,12 @@ struct BasicOption : protected ConstructingProfile {
         return static_cast<Derived&>(*this);
     }
 
+    // the callback may run on the executor given to parse, concurrently with the others
+    constexpr Derived& independent() noexcept {
+        this->behavior(kIndependent);
+        return static_cast<Derived&>(*this);
+    }
+
     constexpr Derived& required() noexcept {
         this->behavior(kRequired);
         return static_cast<Derived&>(*this);
@@ -176,11 +224,37 @@ struct BasicOption : protected ConstructingProfile {
         return static_cast<Derived&>(*this);
     }
 
+    // converts to kCodeChoice, a token must be one of Names, its index is stored
+    template <utils::FixedString... Names>
+    constexpr Derived& choices() noexcept {
+        this->choose_from(&values::ChoiceSet<Names...>::table);
+        return static_cast<Derived&>(*this);
+    }
+
+    // converts to kCodeCustom, conv must outlive the context (usually an inline constexpr)
+    constexpr Derived& convert_with(const values::Converter* conv) noexcept {
+        this->convert_by(conv);
+        return static_cast<Derived&>(*this);
+    }
+
+    // a token is a delim separated list, every element goes to the sink, the token counts as a single narg
+    constexpr Derived& delimiter(char delim) noexcept {
+        this->split_on(delim);
+        return static_cast<Derived&>(*this);
+    }
+
+    // options sharing an exclusion point can't be called together
     constexpr Derived& exclude(NumT n) noexcept {
         this->exclude_on(n);
         return static_cast<Derived&>(*this);
     }
 
+    // at least one option sharing a group point must be called
+    constexpr Derived& one_of(NumT n) noexcept {
+        this->group_on(n);
+        return static_cast<Derived&>(*this);
+    }
+
     constexpr const ConstructingProfile& profile() const noexcept { return *this; }
 };
 
@@ -211,11 +285,36 @@ struct BasicPosarg : protected ConstructingProfile {
         return static_cast<Derived&>(*this);
     }
 
+    // the callback may run on the executor given to parse, concurrently with the others
+    constexpr Derived& independent() noexcept {
+        this->behavior(kIndependent);
+        return static_cast<Derived&>(*this);
+    }
+
     constexpr Derived& convert(const TypeCodeT& code) noexcept{
         this->convert_to(code);
         return static_cast<Derived&>(*this);
     }
 
+    // converts to kCodeChoice, a token must be one of Names, its index is stored
+    template <utils::FixedString... Names>
+    constexpr Derived& choices() noexcept {
+        this->choose_from(&values::ChoiceSet<Names...>::table);
+        return static_cast<Derived&>(*this);
+    }
+
+    // converts to kCodeCustom, conv must outlive the context (usually an inline constexpr)
+    constexpr Derived& convert_with(const values::Converter* conv) noexcept {
+        this->convert_by(conv);
+        return static_cast<Derived&>(*this);
+    }
+
+    // a token is a delim separated list, every element goes to the sink, the token counts as a single narg
+    constexpr Derived& delimiter(char delim) noexcept {
+        this->split_on(delim);
+        return static_cast<Derived&>(*this);
+    }
+
     constexpr Derived& order(NumT pos) noexcept {
         this->pos_order(pos);
         return static_cast<Derived&>(*this);
@@ -269,12 +368,16 @@ struct static_profile {
     const NameType lname = nullptr;
     const NameType sname = nullptr;
     const NameType desc = "";
-    const WholeNumT call_limit = 1;
+    const WholeNumT call_limit = 0;
     const WholeNumT narg = 0;
     const NumT positional_order = 0;
     const FlagType behave = 0;
     const NumT exclude_point = -1;
+    const NumT group_point = -1;
     const TypeCodeT convert_code = 0;
+    const values::ChoiceTable* const choices = nullptr;
+    const values::Converter* const converter = nullptr;
+    const char delimiter = '\0';
     const bool is_posarg = false;
 
     static_profile() = delete;
@@ -288,7 +391,11 @@ struct static_profile {
         positional_order(construct_prof.positional_order),
         behave(construct_prof.behave),
         exclude_point(construct_prof.exclude_point),
+        group_point(construct_prof.group_point),
         convert_code(construct_prof.convert_code),
+        choices(construct_prof.choice_table),
+        converter(construct_prof.converter),
+        delimiter(construct_prof.delim),
         is_posarg(construct_prof.posarg)
     {
         construct_prof.verify();
@@ -296,19 +403,51 @@ struct static_profile {
 
     constexpr static_profile(const static_profile& oth) = default;
 };
+
+/*
+The part of a static_profile the parse core reads on every token,
+packed so a whole table of them stays in a few cache lines,
+names, description, converter and choices stay in the static_profile
+*/
+struct hot_profile {
+    static constexpr std::uint8_t posarg_bit = 1 << 7;
+
+    WholeNumT narg = 0;
+    std::uint16_t call_limit = 0; // 0 = unlimited
+    std::uint8_t behave = 0; // behavior flags, posarg_bit for posargs
+    TypeCodeT convert_code = 0;
+
+    constexpr hot_profile() = default;
+    constexpr hot_profile(const static_profile& prof) noexcept
+    :
+        narg(prof.narg),
+        call_limit(static_cast<std::uint16_t>(prof.call_limit)),
+        behave(static_cast<std::uint8_t>(prof.behave | (prof.is_posarg ? posarg_bit : 0))),
+        convert_code(prof.convert_code)
+    {}
+
+    constexpr bool is_posarg() const noexcept { return (behave & posarg_bit) != 0; }
+};
+
+static_assert(sizeof(hot_profile) <= 8, "hot_profile must stay within 8 bytes");
+static_assert((kRequired | kRestricted | kImmediate | kIndependent) < hot_profile::posarg_bit);
+struct modifiable_profile;
+
+inline void no_callback(const static_profile&, modifiable_profile&) {}
+
+/*
+modifiable_profile only holds the cold, per-profile setup (callback and sink),
+call state lives in mapper::RuntimeState as dense arrays
+*/
 struct modifiable_profile {
-    bool is_called = false;
-    WholeNumT call_count = 0;
-    WholeNumT fulfilled_args = 0;
-    using FunctionType = std::function<void(static_profile, modifiable_profile&)>;
-    FunctionType callback = [](static_profile, modifiable_profile&){};
+    using FunctionType = std::function<void(const static_profile&, modifiable_profile&)>;
+    FunctionType callback = no_callback;
     values::BoundValue bval;
-    WholeNumT call_frequent() const noexcept { return call_count; }
     modifiable_profile& bind(auto var) { bval.bind(var); return *this; }
     modifiable_profile& set_callback(FunctionType&& func) { callback = func; return *this; }
 };
 
-const char* get_name(const static_profile& prof) {
+constexpr const char* get_name(const static_profile& prof) noexcept {
     return (prof.lname ? prof.lname : prof.sname);
 }
 
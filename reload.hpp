@@ -0,0 +1,138 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "commons.hpp"
+#include "exceptions.hpp"
+#include "mapper.hpp"
+#include "parser.hpp"
+#include "utils.hpp"
+
+namespace sp {
+
+namespace reload {
+
+/*
+Incremental re-parse
+
+Reloader re-parses a command set into the same RuntimeContext and
+compares the result with the previous successful parse, profile by
+profile : called state, call count and values (strings by content).
+Only the callbacks of called profiles that changed run,
+changed() holds every changed profile, the ones no longer called included
+(their callback doesn't run, check is_called to tear them down).
+
+Each called profile keeps an exact copy of its result (call count,
+then the kind and bytes of every value), compared byte for byte,
+the buffers are reused from one parse to the next.
+kCodeCustom profiles have no comparable form and count as changed
+whenever they are called.
+A failed parse leaves the stored results untouched, the next parse
+compares with the last successful one. Immediate callbacks
+still fire while parsing.
+*/
+
+// what is known of a profile's last result
+enum class Seen : std::uint8_t { Uncalled, Uncomparable, Stored };
+
+// exact encoding of the called result of a profile, strings by content
+inline void encode(const mapper::FindPair& complete_prof, WholeNumT call_count, std::string& out) {
+    out.assign(reinterpret_cast<const char*>(&call_count), sizeof(call_count));
+    complete_prof.second->bval.for_each_value([&out](const Blob& val) {
+        out.push_back(static_cast<char>(val.index()));
+        if(const IntT* num = std::get_if<IntT>(&val))
+            out.append(reinterpret_cast<const char*>(num), sizeof(*num));
+        else if(const DobT* dob = std::get_if<DobT>(&val))
+            out.append(reinterpret_cast<const char*>(dob), sizeof(*dob));
+        else if(const StrT* str = std::get_if<StrT>(&val))
+            out.append(*str, std::strlen(*str) + 1);
+    });
+}
+
+class Reloader {
+    private :
+    std::vector<Seen> seen;
+    std::vector<std::string> results;
+    std::string scratch;
+    std::vector<BitWord> changed_bits;
+
+    public :
+
+    explicit Reloader(const mapper::RuntimeView& rmap)
+        : seen(rmap.existing_profile(), Seen::Uncalled),
+          results(rmap.existing_profile()),
+          changed_bits(utils::bit_words(rmap.existing_profile()), 0) {}
+
+    // the runtime state is reset first, callbacks run for the changed called profiles only
+    std::span<const BitWord> parse_core(
+        mapper::RuntimeView& rmap,
+        const char** argv,
+        std::size_t argc,
+        std::span<const char*> dump_slots,
+        FlagType parse_flags = 0
+    ) {
+        if(rmap.existing_profile() != seen.size())
+            throw except::SetupError("Reloader used with another RuntimeContext");
+
+        rmap.reset();
+        parser::parse_values(rmap, parser::TokenCursor{argv, argc}, dump_slots, parse_flags);
+
+        const mapper::RuntimeState& state = rmap.state();
+        utils::bit_clear_all(changed_bits);
+        for(std::size_t i = 0; i < seen.size(); i++) {
+            Seen curr = Seen::Uncalled;
+            if(state.is_called(i)) {
+                mapper::FindPair complete_prof = rmap[i];
+                if(complete_prof.hot->convert_code == kCodeCustom) {
+                    curr = Seen::Uncomparable;
+                } else {
+                    curr = Seen::Stored;
+                    encode(complete_prof, state.call_count[i], scratch);
+                }
+            }
+
+            bool changed = (curr != seen[i]) or (curr == Seen::Uncomparable)
+                or ((curr == Seen::Stored) && (scratch != results[i]));
+            if(changed) utils::bit_set(changed_bits, i);
+            if(changed && (curr == Seen::Stored)) results[i].swap(scratch);
+            seen[i] = curr;
+        }
+
+        for(std::size_t w = 0; w < changed_bits.size(); w++) {
+            BitWord curr = changed_bits[w] & state.called[w];
+            while(curr) {
+                mapper::FindPair complete_prof = rmap[(w * utils::word_bits) + std::countr_zero(curr)];
+                complete_prof.second->callback(*complete_prof.first, *complete_prof.second);
+                curr &= (curr - 1);
+            }
+        }
+        return changed_bits;
+    }
+
+    template <std::size_t IDCount, std::size_t dump_size>
+    std::span<const BitWord> parse(
+        mapper::RuntimeMapper<IDCount>& rmap,
+        const char** argv,
+        int argc,
+        parser::DumpSize<dump_size>,
+        FlagType parse_flags = 0
+    ) {
+        std::array<const char*, dump_size> dump{};
+        return parse_core(rmap, argv, static_cast<std::size_t>(argc), dump, parse_flags);
+    }
+
+    std::span<const BitWord> changed() const noexcept { return changed_bits; }
+    bool is_changed(std::size_t idx) const noexcept { return utils::bit_test(changed_bits, idx); }
+
+    // next parse reports every called profile as changed
+    void forget() noexcept { for(auto& state : seen) state = Seen::Uncalled; }
+};
+
+}
+}
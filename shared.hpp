@@ -0,0 +1,309 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <span>
+#include <utility>
+#include <variant>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "commons.hpp"
+#include "exceptions.hpp"
+#include "mapper.hpp"
+#include "utils.hpp"
+
+namespace sp {
+
+namespace shared {
+
+/*
+Shared-memory export of a parsed state (POSIX only)
+
+The master parses once and exports the result into a memfd
+(shm_open where memfd is missing), prefork workers inherit the fd
+and map it read-only, values are read in place through the
+profile indices of the same StaticContext.
+
+Layout, every position is an offset from the segment start :
+    Header
+    called bitset       BitWord[bit_words(prof_count)]
+    call counts         WholeNumT[prof_count]
+    fulfilled args      WholeNumT[prof_count]
+    value ranges        Range[prof_count]
+    values              Value[value_count]
+    string bytes        null-terminated payloads of the StrT values
+
+The memfd is sealed once written (no write, no resize), it isn't
+close-on-exec so spawned workers inherit it as well.
+Custom values have no Blob form, only their called bit and counters are exported.
+*/
+
+inline constexpr std::uint32_t kMagic = 0x48535053; // "SPSH"
+inline constexpr std::uint32_t kVersion = 1;
+
+struct Header {
+    std::uint32_t magic = kMagic;
+    std::uint32_t version = kVersion;
+    std::uint64_t layout_hash = 0;
+    std::uint64_t size = 0;
+    std::uint32_t prof_count = 0;
+    std::uint32_t value_count = 0;
+};
+
+struct Range {
+    std::uint32_t begin = 0;
+    std::uint32_t count = 0;
+};
+
+// payload is the integer, the double bits or the string offset, kind is the Blob index
+struct Value {
+    std::uint64_t payload = 0;
+    std::uint32_t kind = 0;
+    std::uint32_t length = 0;
+};
+
+static_assert(sizeof(Value) == 16);
+
+// profile names, types and nargs, a worker built from another StaticContext is rejected
+inline std::uint64_t layout_hash(const mapper::StaticView& statics) noexcept {
+    std::uint64_t hash = utils::fnv_offset;
+    for(const profiles::static_profile& prof : statics.profiles) {
+        const char* names[] = {prof.lname, prof.sname};
+        for(const char* name : names)
+            hash = name ? utils::fnv1a(name, std::strlen(name) + 1, hash) : utils::fnv1a("", 1, hash);
+        std::uint64_t shape = (std::uint64_t(prof.convert_code.value()) << 32) | prof.narg;
+        hash = utils::fnv1a(reinterpret_cast<const char*>(&shape), sizeof(shape), hash);
+    }
+    return hash;
+}
+
+struct Offsets {
+    std::size_t called = 0;
+    std::size_t counts = 0;
+    std::size_t fulfilled = 0;
+    std::size_t ranges = 0;
+    std::size_t values = 0;
+    std::size_t strings = 0;
+};
+
+constexpr std::size_t align8(std::size_t n) noexcept { return (n + 7) & ~std::size_t(7); }
+
+constexpr Offsets layout(std::size_t prof_count, std::size_t value_count) noexcept {
+    Offsets at{};
+    at.called = align8(sizeof(Header));
+    at.counts = at.called + (utils::bit_words(prof_count) * sizeof(BitWord));
+    at.fulfilled = at.counts + (prof_count * sizeof(WholeNumT));
+    at.ranges = align8(at.fulfilled + (prof_count * sizeof(WholeNumT)));
+    at.values = at.ranges + (prof_count * sizeof(Range));
+    at.strings = at.values + (value_count * sizeof(Value));
+    return at;
+}
+
+class Segment {
+    private :
+    int fd = -1;
+    const std::byte* data = nullptr;
+    std::size_t map_size = 0;
+    Offsets at{};
+
+    template <typename T>
+    const T* table(std::size_t offset) const noexcept { return reinterpret_cast<const T*>(data + offset); }
+
+    const Header& header() const noexcept { return *table<Header>(0); }
+
+    [[noreturn]] void fail(const char* what) {
+        release();
+        throw except::SetupError(what);
+    }
+
+    static int create_fd(const char* name) noexcept {
+#if defined(MFD_ALLOW_SEALING)
+        return ::memfd_create(name, MFD_ALLOW_SEALING);
+#else
+        char shm_name[64];
+        std::snprintf(shm_name, sizeof(shm_name), "/%.40s.%ld", name, static_cast<long>(::getpid()));
+        int new_fd = ::shm_open(shm_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if(new_fd >= 0) ::shm_unlink(shm_name);
+        return new_fd;
+#endif
+    }
+
+    void write_state(mapper::RuntimeView& rmap) {
+        const mapper::RuntimeState& state = rmap.state();
+        const std::size_t prof_count = rmap.existing_profile();
+
+        std::size_t value_count = 0;
+        std::size_t string_bytes = 0;
+        utils::for_each_bit(state.called, [&](std::size_t i) {
+            rmap[i].second->bval.for_each_value([&](const Blob& val) {
+                ++value_count;
+                if(const StrT* str = std::get_if<StrT>(&val)) string_bytes += std::strlen(*str) + 1;
+            });
+        });
+
+        at = layout(prof_count, value_count);
+        map_size = at.strings + string_bytes;
+        if(::ftruncate(fd, static_cast<off_t>(map_size)) != 0) fail("Shared segment : can't size the segment");
+
+        void* mapping = ::mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(mapping == MAP_FAILED) fail("Shared segment : can't map the segment for writing");
+        std::byte* out = static_cast<std::byte*>(mapping);
+
+        Header head{};
+        head.layout_hash = layout_hash(rmap.statics());
+        head.size = map_size;
+        head.prof_count = static_cast<std::uint32_t>(prof_count);
+        head.value_count = static_cast<std::uint32_t>(value_count);
+        std::memcpy(out, &head, sizeof(head));
+        std::memcpy(out + at.called, state.called.data(), state.called.size_bytes());
+        std::memcpy(out + at.counts, state.call_count.data(), state.call_count.size_bytes());
+        std::memcpy(out + at.fulfilled, state.fulfilled_args.data(), state.fulfilled_args.size_bytes());
+
+        Range* ranges = reinterpret_cast<Range*>(out + at.ranges);
+        Value* values = reinterpret_cast<Value*>(out + at.values);
+        std::size_t curr_value = 0;
+        std::size_t curr_string = 0;
+        utils::for_each_bit(state.called, [&](std::size_t i) {
+            ranges[i].begin = static_cast<std::uint32_t>(curr_value);
+            rmap[i].second->bval.for_each_value([&](const Blob& val) {
+                Value& slot = values[curr_value++];
+                slot.kind = static_cast<std::uint32_t>(val.index());
+                if(const IntT* num = std::get_if<IntT>(&val)) {
+                    slot.payload = static_cast<std::uint64_t>(static_cast<std::int64_t>(*num));
+                } else if(const DobT* dob = std::get_if<DobT>(&val)) {
+                    slot.payload = std::bit_cast<std::uint64_t>(*dob);
+                } else if(const StrT* str = std::get_if<StrT>(&val)) {
+                    std::size_t len = std::strlen(*str);
+                    std::memcpy(out + at.strings + curr_string, *str, len + 1);
+                    slot.payload = curr_string;
+                    slot.length = static_cast<std::uint32_t>(len);
+                    curr_string += len + 1;
+                }
+            });
+            ranges[i].count = static_cast<std::uint32_t>(curr_value - ranges[i].begin);
+        });
+
+        ::munmap(mapping, map_size);
+#if defined(F_ADD_SEALS)
+        ::fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+#endif
+    }
+
+    void map_read_only() {
+        void* mapping = ::mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, 0);
+        if(mapping == MAP_FAILED) fail("Shared segment : can't map the segment");
+        data = static_cast<const std::byte*>(mapping);
+    }
+
+    // everything a worker reads is bounds-checked once here
+    void check(const mapper::StaticView& statics) {
+        if(map_size < sizeof(Header)) fail("Shared segment : truncated header");
+        const Header& head = header();
+        if((head.magic != kMagic) or (head.version != kVersion)) fail("Shared segment : not a static_parser segment");
+        if(head.size != map_size) fail("Shared segment : size mismatch");
+        if((head.prof_count != statics.profiles.size()) or (head.layout_hash != layout_hash(statics)))
+            fail("Shared segment : exported from another StaticContext");
+
+        at = layout(head.prof_count, head.value_count);
+        if(at.strings > map_size) fail("Shared segment : truncated tables");
+        std::size_t string_bytes = map_size - at.strings;
+
+        for(const Range& range : std::span(table<Range>(at.ranges), head.prof_count))
+            if((std::size_t(range.begin) + range.count) > head.value_count) fail("Shared segment : value range out of bounds");
+        for(const Value& val : std::span(table<Value>(at.values), head.value_count)) {
+            if(val.kind >= std::variant_size_v<Blob>) fail("Shared segment : unknown value kind");
+            if(val.kind != Blob(StrT{}).index()) continue;
+            if((val.payload >= string_bytes) or ((string_bytes - val.payload) <= val.length)
+                or (std::to_integer<char>(data[at.strings + val.payload + val.length]) != '\0'))
+                fail("Shared segment : string out of bounds");
+        }
+    }
+
+    void release() noexcept {
+        if(data) ::munmap(const_cast<std::byte*>(data), map_size);
+        if(fd >= 0) ::close(fd);
+        data = nullptr;
+        fd = -1;
+    }
+
+    public :
+
+    // master side, exports the state of a parsed (verified) context
+    explicit Segment(mapper::RuntimeView& rmap, const char* name = "static_parser") {
+        fd = create_fd(name);
+        if(fd < 0) throw except::SetupError("Shared segment : can't create the memory file");
+        write_state(rmap);
+        map_read_only();
+    }
+
+    // worker side, takes ownership of fd, statics must come from the StaticContext of the master
+    Segment(int inherited_fd, const mapper::StaticView& statics) : fd(inherited_fd) {
+        struct stat info{};
+        if(::fstat(fd, &info) != 0) fail("Shared segment : can't stat the segment");
+        map_size = static_cast<std::size_t>(info.st_size);
+        if(!map_size) fail("Shared segment : empty segment");
+        map_read_only();
+        check(statics);
+    }
+
+    Segment(const Segment&) = delete;
+    Segment& operator=(const Segment&) = delete;
+
+    Segment(Segment&& oth) noexcept
+        : fd(std::exchange(oth.fd, -1)), data(std::exchange(oth.data, nullptr)),
+          map_size(oth.map_size), at(oth.at) {}
+
+    Segment& operator=(Segment&& oth) noexcept {
+        if(this != &oth) {
+            release();
+            fd = std::exchange(oth.fd, -1);
+            data = std::exchange(oth.data, nullptr);
+            map_size = oth.map_size;
+            at = oth.at;
+        }
+        return *this;
+    }
+
+    ~Segment() { release(); }
+
+    // pass it to the workers (fork, or spawn with the number on the command line)
+    int file() const noexcept { return fd; }
+    std::size_t size() const noexcept { return map_size; }
+    std::size_t profile_count() const noexcept { return header().prof_count; }
+
+    bool is_called(std::size_t idx) const noexcept {
+        return (idx < profile_count())
+            && utils::bit_test(std::span(table<BitWord>(at.called), utils::bit_words(profile_count())), idx);
+    }
+    WholeNumT call_count(std::size_t idx) const noexcept { return table<WholeNumT>(at.counts)[idx]; }
+    WholeNumT fulfilled_args(std::size_t idx) const noexcept { return table<WholeNumT>(at.fulfilled)[idx]; }
+
+    std::span<const Value> values(std::size_t idx) const noexcept {
+        if(!is_called(idx)) return {};
+        const Range& range = table<Range>(at.ranges)[idx];
+        return std::span(table<Value>(at.values) + range.begin, range.count);
+    }
+
+    // StrT values point into the mapping, valid while the segment lives
+    Blob value(const Value& val) const noexcept {
+        switch(val.kind) { // Blob indices
+            case 1 : return static_cast<IntT>(static_cast<std::int64_t>(val.payload));
+            case 2 : return std::bit_cast<DobT>(val.payload);
+            case 3 : return StrT(reinterpret_cast<const char*>(data + at.strings + val.payload));
+            default : return Blob{};
+        }
+    }
+
+    Blob value(std::size_t idx, std::size_t nth) const noexcept {
+        std::span<const Value> vals = values(idx);
+        return (nth < vals.size()) ? value(vals[nth]) : Blob{};
+    }
+};
+
+}
+}
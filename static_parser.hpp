@@ -7,11 +7,27 @@
 #include "utils.hpp"
 #include "values.hpp"
 #include "profiles.hpp"
+#include "convert.hpp"
+#include "executor.hpp"
 #include "mapper.hpp"
 #include "parser.hpp"
+#include "cache.hpp"
+#include "reload.hpp"
+#include "pool.hpp"
+#include "tokenizer.hpp"
+#include "stream.hpp"
+#include "complete.hpp"
+#if __has_include(<sys/mman.h>)
+#include "config.hpp"
+#include "shared.hpp"
+#endif
 
 #include <frozen/unordered_map.h>
 #include <array>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 
 namespace sp {
 
@@ -24,6 +40,10 @@ using IntRef = values::IntRef;
 using DobRef = values::DobRef;
 using StrRef = values::StrRef;
 using TrackSpan = values::TrackingSpan;
+using IntArr = values::IntArr;
+using DobArr = values::DobArr;
+using StrArr = values::StrArr;
+using CustomSink = values::TrackingCustom;
 
 template <profiles::DenotedProfile... Prof>
 constexpr std::size_t count_id() {
@@ -32,10 +52,10 @@ constexpr std::size_t count_id() {
 
 template <std::size_t IDCount, std::size_t... Is>
 constexpr auto make_map_pairs(
-    const std::array<std::pair<sp::NameType, const profiles::static_profile*>, IDCount>& pairs,
+    const std::array<std::pair<sp::NameType, std::size_t>, IDCount>& pairs,
     std::index_sequence<Is...>
 ) {
-    return std::array<std::pair<frozen::string, const profiles::static_profile*>, IDCount>
+    return std::array<std::pair<frozen::string, std::size_t>, IDCount>
         {{
             {frozen::string(pairs[Is].first), pairs[Is].second}...
         }};
@@ -43,15 +63,15 @@ constexpr auto make_map_pairs(
 
 template <std::size_t IDCount>
 constexpr auto make_map(std::span<const profiles::static_profile> profs) {
-    std::array<std::pair<sp::NameType, const profiles::static_profile*>, IDCount> pairs{};
+    std::array<std::pair<sp::NameType, std::size_t>, IDCount> pairs{};
     std::size_t curr_idx = 0;
-    for(const auto& prof : profs) {
-        if(prof.lname) pairs[curr_idx++] = {prof.lname, &prof};
-        if(prof.sname) pairs[curr_idx++] = {prof.sname, &prof};
+    for(std::size_t i = 0; i < profs.size(); i++) {
+        if(profs[i].lname) pairs[curr_idx++] = {profs[i].lname, i};
+        if(profs[i].sname) pairs[curr_idx++] = {profs[i].sname, i};
     }
     
     return
-        frozen::make_unordered_map<frozen::string, const profiles::static_profile*, IDCount>(
+        frozen::make_unordered_map<frozen::string, std::size_t, IDCount>(
             make_map_pairs(pairs, std::make_index_sequence<IDCount>{})
         );
 }
@@ -66,7 +86,10 @@ constexpr std::size_t count_posarg() {
 
 template <std::size_t IDCount, std::size_t ProfCount, std::size_t PosargCount>
 struct StaticContext {
-    using MapType = frozen::unordered_map<frozen::string, const profiles::static_profile*, IDCount>;
+    using MapType = frozen::unordered_map<frozen::string, std::size_t, IDCount>;
+    static constexpr std::size_t id_count = IDCount;
+    static constexpr std::size_t prof_count = ProfCount;
+    static constexpr std::size_t posarg_count = PosargCount;
     
     mapper::ProfileTable<ProfCount, PosargCount> ptable;
     mapper::StaticMapper<IDCount> smapper;
@@ -78,6 +101,18 @@ struct StaticContext {
 };
 
 
+/*
+Direct initialization keeps the context readable in constant expressions,
+which TypedRuntimeContext needs :
+    constexpr sp::StaticContext sctx{ sp::dnOpt()..., ... };
+*/
+template <profiles::DenotedProfile... Prof>
+StaticContext(Prof&&... prof) -> StaticContext<
+    count_id<std::decay_t<Prof>...>(),
+    sizeof...(Prof),
+    count_posarg<std::decay_t<Prof>...>()
+>;
+
 template <profiles::DenotedProfile... Prof>
 constexpr auto make_sctx(Prof&&... prof) {
     return
@@ -88,6 +123,20 @@ constexpr auto make_sctx(Prof&&... prof) {
         > (std::forward<Prof>(prof)...);
 }
 
+/*
+No dynamic initialization : every table of the library is inline constexpr,
+a StaticContext is built by the compiler and destroyed trivially,
+nothing runs before main nor is registered for exit.
+The probe below stops the build if that ever changes.
+*/
+namespace detail {
+    constinit inline const StaticContext startup_probe{
+        profiles::dnOption()["-p"]("--probe").nargs(1).convert(kCodeInt).restricted(),
+        profiles::Posarg()("probes").nargs(1).convert(kCodeStr)
+    };
+    static_assert(std::is_trivially_destructible_v<std::remove_cv_t<decltype(startup_probe)>>);
+}
+
 struct Request {
     profiles::modifiable_profile mprof;
     NameType name_request;
@@ -99,31 +148,59 @@ struct Request {
 template <typename T>
 concept IsRequest = std::is_same_v<std::decay_t<T>, Request>;
 
+// RuntimeContext tag, requests are applied but verify() is left to the caller
+struct DeferVerify {};
+
 template <std::size_t IDCount, std::size_t ProfCount>
 struct RuntimeContext {
     private :
     std::array<profiles::modifiable_profile, ProfCount> mprofs{};
+    std::array<BitWord, utils::bit_words(ProfCount)> called{};
+    std::array<WholeNumT, ProfCount> call_count{};
+    std::array<WholeNumT, ProfCount> fulfilled_args{};
+    std::array<parser::StoreOp, ProfCount> stores{};
 
     public :
     mapper::RuntimeMapper<IDCount> mapper;
 
     template <IsRequest... Req>
     RuntimeContext(const mapper::StaticMapper<IDCount>& smapper, Req&&... req)
-     : mapper(smapper, this->mprofs)
+     : RuntimeContext(DeferVerify{}, smapper, std::forward<Req>(req)...)
+    {
+        mapper.verify();
+    }
+
+    template <IsRequest... Req>
+    RuntimeContext(DeferVerify, const mapper::StaticMapper<IDCount>& smapper, Req&&... req)
+     : mapper(smapper, this->mprofs, mapper::RuntimeState{called, call_count, fulfilled_args, stores})
     {
         auto apply_request = [&](Request& request) -> void {
-            static const profiles::static_profile* ptr = nullptr;
-            static std::size_t idx = 0;
-            if(!(ptr = smapper[request.name_request]))
-                throw except::SetupError(request.name_request + std::string(" is not registered in StaticMapper [RuntimeContext ctor]"));
-            if((idx = smapper.profile_index(ptr)) >= ProfCount)
-                throw except::SetupError(std::to_string(idx) + " Index is out of bounds [RuntimeContext ctor]");
+            std::size_t idx = 0;
+            if((idx = smapper[request.name_request]) == mapper::npos_profile)
+                throw except::SetupError(except::Diagnostic{
+                    .kind = except::ErrorKind::UnregisteredName,
+                    .token = request.name_request
+                });
+            if(idx >= ProfCount)
+                throw except::SetupError(except::Diagnostic{
+                    .kind = except::ErrorKind::IndexOutOfBounds,
+                    .amount = static_cast<std::int64_t>(idx)
+                });
             mprofs[idx] = std::move(request.mprof);
         };
 
         (apply_request(req), ...);
-        mapper.verify();
     }
+
+    RuntimeContext(const RuntimeContext&) = delete;
+    RuntimeContext& operator=(const RuntimeContext&) = delete;
+
+    // only meaningful before verify(), see DeferVerify
+    profiles::modifiable_profile& modifiable(std::size_t idx) noexcept { return mprofs[idx]; }
+    void verify() { mapper.verify(); }
+
+    void reset() { mapper.reset(); }
+    void clear() { mapper.clear(); }
 };
 
 template <std::size_t IDCount, std::size_t ProfCount, std::size_t PosargCount, IsRequest... Req>
@@ -131,4 +208,104 @@ RuntimeContext<IDCount, ProfCount>
 make_rctx(const StaticContext<IDCount, ProfCount, PosargCount>& sctx, Req&&... req) {
     return RuntimeContext<IDCount, ProfCount>(sctx.smapper, std::forward<Req>(req)...);
 }
+
+/*
+RuntimeContext owning a typed storage for every profile of Sctx,
+results are read with get<"name">(), the name is resolved at compile time
+and the return type follows the profile :
+    narg 0                    bool, is the profile called
+    narg 1 and restricted     const T&
+    otherwise                 std::span<const T> of the parsed values
+with T the value type of convert_code. Non restricted profiles
+get max(narg, GreedyCapacity) slots to take their extra tokens.
+
+Requests only contribute callbacks, every sink is bound to the owned storage,
+except kCodeCustom profiles : their value type is erased, bind them through a request
+(get returns whether they were called).
+Contexts are neither copyable nor movable, construct them in place.
+Sctx must be directly initialized (see the StaticContext deduction guide),
+GCC doesn't let constant expressions read a context returned by make_sctx.
+*/
+template <const auto& Sctx, std::size_t GreedyCapacity = 8>
+class TypedRuntimeContext
+    : public RuntimeContext<std::remove_cvref_t<decltype(Sctx)>::id_count, std::remove_cvref_t<decltype(Sctx)>::prof_count>
+{
+    private :
+    using SctxT = std::remove_cvref_t<decltype(Sctx)>;
+    using Base = RuntimeContext<SctxT::id_count, SctxT::prof_count>;
+
+    struct NoSlot {};
+
+    template <std::size_t I>
+    static constexpr const profiles::static_profile& prof() noexcept { return Sctx.ptable.static_profiles[I]; }
+
+    template <std::size_t I>
+    static constexpr auto make_slot() {
+        constexpr const profiles::static_profile& sprof = prof<I>();
+        using T = typename values::code_value<sprof.convert_code.value()>::type;
+        constexpr bool restricted = profiles::is_restricted(sprof.behave);
+        constexpr std::size_t capacity = (restricted or (sprof.narg > GreedyCapacity)) ? sprof.narg : GreedyCapacity;
+
+        if constexpr (std::is_void_v<T> or (sprof.narg == 0))
+            return NoSlot{};
+        else
+            return values::TypedSlot<T, capacity, (restricted && (sprof.narg == 1))>{};
+    }
+
+    template <std::size_t... Is>
+    static auto make_storage(std::index_sequence<Is...>) -> std::tuple<decltype(make_slot<Is>())...>;
+
+    using Storage = decltype(make_storage(std::make_index_sequence<SctxT::prof_count>{}));
+    Storage storage{};
+
+    template <std::size_t... Is>
+    void bind_storage(std::index_sequence<Is...>) {
+        auto bind_one = [this]<std::size_t I>(std::integral_constant<std::size_t, I>) {
+            auto& slot = std::get<I>(storage);
+            if constexpr (!std::is_same_v<std::decay_t<decltype(slot)>, NoSlot>)
+                this->modifiable(I).bval.bind(slot.sink());
+        };
+        (bind_one(std::integral_constant<std::size_t, Is>{}), ...);
+    }
+
+    static constexpr std::size_t index_of(std::string_view name) {
+        for(std::size_t i = 0; i < SctxT::prof_count; i++) {
+            const profiles::static_profile& sprof = Sctx.ptable.static_profiles[i];
+            if((sprof.lname && (std::string_view(sprof.lname) == name))
+                or (sprof.sname && (std::string_view(sprof.sname) == name)))
+                return i;
+        }
+        return SctxT::prof_count;
+    }
+
+    public :
+
+    template <IsRequest... Req>
+    explicit TypedRuntimeContext(Req&&... req)
+        : Base(DeferVerify{}, Sctx.smapper, std::forward<Req>(req)...)
+    {
+        bind_storage(std::make_index_sequence<SctxT::prof_count>{});
+        this->verify();
+    }
+
+    template <utils::FixedString Name>
+    static constexpr std::size_t index() noexcept {
+        constexpr std::size_t idx = index_of(Name.view());
+        static_assert(idx < SctxT::prof_count, "Unknown profile name in TypedRuntimeContext::get");
+        return idx;
+    }
+
+    template <utils::FixedString Name>
+    decltype(auto) get() const noexcept {
+        constexpr std::size_t idx = index<Name>();
+        const auto& slot = std::get<idx>(storage);
+        if constexpr (std::is_same_v<std::decay_t<decltype(slot)>, NoSlot>)
+            return this->mapper.is_called(idx);
+        else
+            return slot.get();
+    }
+
+    template <utils::FixedString Name>
+    bool called() const noexcept { return this->mapper.is_called(index<Name>()); }
+};
 }
\ No newline at end of file
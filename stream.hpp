@@ -0,0 +1,254 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "commons.hpp"
+#include "exceptions.hpp"
+#include "mapper.hpp"
+#include "parser.hpp"
+
+namespace sp {
+
+namespace stream {
+
+/*
+Streaming parse of NUL-delimited arguments (find -print0, xargs -0)
+
+The input is read in fixed-size chunks and tokenized in place,
+nothing grows with the input :
+peak memory is chunk_bytes + arena_bytes + batch_tokens pointers.
+
+Option tokens are resolved through the StaticMapper as in argv,
+but take exactly their missing nargs (a greedy option doesn't swallow
+the stream), they are copied with their values into a bounded arena
+so StrT values stay valid once the chunk is recycled.
+Positional tokens go to the sink in batches, as a std::span<const StrT>
+valid during the call only.
+
+The stream grammar has at most one posarg and its tokens are the ones
+the sink receives, its own bound value is left untouched. Another posarg
+would never receive its share, so it is a SetupError. A restricted posarg
+reports its first token past narg as UnexpectedInput, as in parse.
+Once the input ends the posarg is marked called with the positional
+tokens as its fulfilled nargs, then required checks, constraints and
+callbacks run as in parse.
+Diagnostic argv_index is the token ordinal in the stream.
+*/
+
+struct Limits {
+    std::size_t chunk_bytes = 64 * 1024; // longest token + 1 (its NUL)
+    std::size_t arena_bytes = 4 * 1024;  // every option token and value of the stream
+    std::size_t batch_tokens = 1024;
+};
+
+class NulStream {
+    private :
+    std::FILE* input = nullptr;
+    std::vector<char> chunk; // chunk_bytes of input and a spare byte to terminate the last token
+    std::vector<char> arena;
+    std::vector<const char*> batch;
+    std::vector<const char*> group; // pending option and its values, inside the arena
+    std::size_t chunk_begin = 0;
+    std::size_t chunk_end = 0;
+    std::size_t arena_used = 0;
+    std::size_t group_left = 0;
+    std::uint64_t group_at = 0;
+    std::uint64_t token_total = 0;
+    std::uint64_t posarg_total = 0;
+    bool input_done = false;
+
+    // formatted before the throw, the token views the chunk or the arena
+    [[noreturn]] static void overflow(std::string_view token, const char* what, std::size_t limit) {
+        except::ParseError err(except::Diagnostic{
+            .kind = except::ErrorKind::StreamOverflow,
+            .amount = static_cast<std::int64_t>(limit),
+            .token = token.substr(0, 32),
+            .other_name = what
+        });
+        err.what();
+        throw err;
+    }
+
+    // next complete token of the chunk, nullptr once the chunk is drained
+    const char* take() noexcept {
+        if(chunk_begin == chunk_end) return nullptr;
+        char* at = chunk.data() + chunk_begin;
+        void* nul = std::memchr(at, '\0', chunk_end - chunk_begin);
+        if(nul) {
+            chunk_begin = static_cast<std::size_t>(static_cast<char*>(nul) - chunk.data()) + 1;
+            return at;
+        }
+        if(!input_done) return nullptr;
+        chunk[chunk_end] = '\0'; // unterminated last token, reads always leave that byte free
+        chunk_begin = chunk_end;
+        return at;
+    }
+
+    // the partial token moves to the chunk front, the batch must be flushed before
+    void refill() {
+        std::size_t tail = chunk_end - chunk_begin;
+        if(tail == (chunk.size() - 1))
+            overflow(std::string_view(chunk.data() + chunk_begin, tail), "chunk", chunk.size() - 1);
+        std::memmove(chunk.data(), chunk.data() + chunk_begin, tail);
+        chunk_begin = 0;
+        chunk_end = tail;
+
+        std::size_t got = std::fread(chunk.data() + chunk_end, 1, (chunk.size() - 1) - chunk_end, input);
+        chunk_end += got;
+        if(!got) {
+            if(std::ferror(input)) throw except::SetupError("Can't read the argument stream");
+            input_done = true;
+        }
+    }
+
+    const char* keep(const char* token) {
+        std::size_t size = std::strlen(token) + 1;
+        if(size > (arena.size() - arena_used)) overflow(token, "option arena", arena.size());
+        char* at = arena.data() + arena_used;
+        std::memcpy(at, token, size);
+        arena_used += size;
+        return at;
+    }
+
+    void begin_option(mapper::RuntimeView& rmap, const char* token, FlagType parse_flags) {
+        group.clear();
+        group.push_back(keep(token));
+        group_at = token_total - 1;
+        group_left = 0;
+
+        std::string_view name(token);
+        if(name.find('=') != std::string_view::npos) return;
+        mapper::FindPair complete_prof = rmap[name];
+        if(!complete_prof.first and (parse_flags & parser::kAllowAbbrev) and (name.size() > 2) and name.starts_with("--")) {
+            bool ambiguous = false;
+            complete_prof = rmap.abbreviated(name, ambiguous);
+        }
+        // unknown names are reported by handle_opt
+        if(complete_prof.first && (complete_prof.hot->narg > rmap.fulfilled_args(complete_prof.index)))
+            group_left = complete_prof.hot->narg - rmap.fulfilled_args(complete_prof.index);
+    }
+
+    void dispatch(mapper::RuntimeView& rmap, FlagType parse_flags) {
+        parser::TokenCursor get{group.data(), group.size()};
+        parser::DumpBuffer no_posarg{std::span<const char*>{}};
+        try {
+            parser::handle_opt(rmap, get, no_posarg, parse_flags);
+        } catch(except::ParseError& err) {
+            except::Diagnostic& diag = err.diagnostic();
+            parser::locate(diag, parser::TokenCursor{group.data(), group.size()});
+            if(diag.argv_index >= 0)
+                diag.argv_index = ordinal_index(group_at + static_cast<std::uint64_t>(diag.argv_index));
+            parser::name_profile(diag, rmap.statics());
+            throw;
+        }
+        group.clear();
+    }
+
+    static std::int32_t ordinal_index(std::uint64_t ordinal) noexcept {
+        return static_cast<std::int32_t>(
+            (ordinal < std::numeric_limits<std::int32_t>::max()) ? ordinal : std::numeric_limits<std::int32_t>::max()
+        );
+    }
+
+    // narg of a restricted posarg, 0 when the posarg takes the whole stream
+    static std::uint64_t posarg_limit(mapper::RuntimeView& rmap) {
+        if(rmap.existing_posarg() > 1)
+            throw except::SetupError("NulStream takes a single posarg, every positional token goes to the sink");
+        if(!rmap.existing_posarg()) return 0;
+        const profiles::hot_profile& hot = *rmap[mapper::PosargIndex(0)].hot;
+        return profiles::is_restricted(hot.behave) ? hot.narg : 0;
+    }
+
+    // formatted before the throw, the token views the chunk
+    [[noreturn]] void unexpected(std::string_view token) const {
+        except::ParseError err(except::Diagnostic{
+            .kind = except::ErrorKind::UnexpectedInput,
+            .argv_index = ordinal_index(token_total - 1),
+            .token = token
+        });
+        err.what();
+        throw err;
+    }
+
+    // the positional tokens went to the sink, the posarg only gets its called state
+    void fill_posarg(mapper::RuntimeView& rmap) {
+        if(!rmap.existing_posarg()) return;
+        const mapper::RuntimeState& state = rmap.state();
+        mapper::FindPair complete_prof = rmap[mapper::PosargIndex(0)];
+        WholeNumT narg = complete_prof.hot->narg;
+
+        ++state.call_count[complete_prof.index];
+        state.fulfilled_args[complete_prof.index] = (posarg_total < narg) ? static_cast<WholeNumT>(posarg_total) : narg;
+        if(posarg_total < narg)
+            throw except::ParseError(except::Diagnostic{
+                .kind = except::ErrorKind::InsufficientNarg,
+                .profile_index = static_cast<std::int32_t>(complete_prof.index),
+                .amount = static_cast<std::int64_t>(narg - posarg_total),
+                .profile_name = profiles::get_name(*complete_prof.first)
+            });
+        state.mark_called(complete_prof.index);
+    }
+
+    public :
+
+    NulStream(std::FILE* new_input, Limits limits = {})
+        : input(new_input), chunk(limits.chunk_bytes + 1), arena(limits.arena_bytes)
+    {
+        if(!input or (limits.chunk_bytes < 2) or !limits.batch_tokens)
+            throw except::SetupError("NulStream needs an input, a chunk of 2 bytes or more and a batch of 1 token or more");
+        batch.reserve(limits.batch_tokens);
+    }
+
+    // sink(std::span<const StrT>) receives the positional tokens, the input is consumed once
+    template <typename Sink>
+    void parse(mapper::RuntimeView& rmap, Sink&& sink, FlagType parse_flags = 0) {
+        const std::uint64_t limit = posarg_limit(rmap);
+        auto flush = [&]() {
+            if(batch.empty()) return;
+            sink(std::span<const StrT>(batch.data(), batch.size()));
+            batch.clear();
+        };
+
+        while(true) {
+            const char* token = take();
+            if(!token) {
+                if(input_done) break;
+                flush();
+                refill();
+                continue;
+            }
+            ++token_total;
+
+            if(!group.empty()) {
+                group.push_back(keep(token));
+                if(!--group_left) dispatch(rmap, parse_flags);
+            } else if((token[0] == '-') && !parser::potential_digit(token)) {
+                begin_option(rmap, token, parse_flags);
+                if(!group_left) dispatch(rmap, parse_flags);
+            } else {
+                if(limit && (posarg_total == limit)) unexpected(token);
+                batch.push_back(token);
+                ++posarg_total;
+                if(batch.size() == batch.capacity()) flush();
+            }
+        }
+        if(!group.empty()) dispatch(rmap, parse_flags); // reports the missing nargs
+        flush();
+
+        fill_posarg(rmap);
+        parser::check_required(rmap);
+        parser::check_constraints(rmap);
+        parser::run_callbacks(rmap);
+    }
+
+    std::uint64_t tokens() const noexcept { return token_total; }
+    std::uint64_t positional() const noexcept { return posarg_total; }
+};
+
+}
+}
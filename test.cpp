@@ -15,7 +15,7 @@ constexpr auto sctx = sp::make_sctx(
         .convert(sp::kCodeStr)
 );
 
-void help_msg(sp::StProf _, sp::ModProf& __) {
+void help_msg(const sp::StProf& _, sp::ModProf& __) {
     std::cout <<
         "Flags : \n" <<
         "-h, --help     = Show this message\n" <<
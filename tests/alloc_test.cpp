@@ -0,0 +1,138 @@
+/*
+Allocation test
+
+Counts every global operator new while building contexts and parsing
+fixed command lines, each step states how many allocations it may make.
+Exits 1 on the first mismatch.
+
+    g++ -std=c++20 -I<frozen>/include tests/alloc_test.cpp -o alloc_test && ./alloc_test
+*/
+#include "../static_parser.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+static std::size_t allocations = 0;
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    if(void* ptr = std::malloc(size ? size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+static int failures = 0;
+
+template <typename Step>
+void expect_allocations(std::size_t expected, const char* name, Step step) {
+    std::size_t since = allocations;
+    step();
+    std::size_t made = allocations - since;
+    std::printf("%-40s %zu allocation(s)%s\n", name, made, (made == expected) ? "" : "  <- FAILED");
+    if(made != expected) ++failures;
+}
+
+// the step must throw Error of the given kind, what() is formatted as part of the step
+template <typename Error, typename Step>
+void expect_error(std::size_t expected, const char* name, sp::except::ErrorKind kind, Step step) {
+    expect_allocations(expected, name, [&] {
+        try {
+            step();
+            std::printf("%s didn't throw\n", name);
+            ++failures;
+        } catch(const Error& err) {
+            if(err.kind() != kind) {
+                std::printf("%s threw : %s\n", name, err.what());
+                ++failures;
+            }
+        }
+    });
+}
+
+void on_verbose(const sp::StProf&, sp::ModProf&) {}
+
+constexpr sp::StaticContext sctx{
+    sp::dnOpt()["-v"]("--verbose").nargs(0).convert(sp::kCodeNone),
+    sp::snOpt()("--color").nargs(0).convert(sp::kCodeNone),
+    sp::dnOpt()["-n"]("--count").nargs(1).convert(sp::kCodeInt).restricted(),
+    sp::dnOpt()["-m"]("--mode").nargs(1).choices<"fast", "safe", "debug">().restricted(),
+    sp::dnOpt()["-w"]("--weights").nargs(1).convert(sp::kCodeDob).delimiter(','),
+    sp::dnOpt()["-o"]("--output").nargs(1).convert(sp::kCodeStr).restricted().required(),
+    sp::Posarg()("files").nargs(1).convert(sp::kCodeStr)
+};
+
+struct Sinks {
+    sp::IntT count = 0;
+    sp::IntT mode = -1;
+    std::array<sp::DobT, 8> weights{};
+    std::size_t weight_count = 0;
+    sp::StrT output = nullptr;
+    std::array<sp::StrT, 8> files{};
+    std::size_t file_count = 0;
+};
+
+auto make_context(Sinks& sinks) {
+    return sp::make_rctx(sctx,
+        sp::Request(sp::ModProf().set_callback(on_verbose), "-v"),
+        sp::Request(sp::ModProf().bind(sp::IntRef(sinks.count)), "-n"),
+        sp::Request(sp::ModProf().bind(sp::IntRef(sinks.mode)), "-m"),
+        sp::Request(sp::ModProf().bind(sp::DobArr(sinks.weights, sinks.weight_count)), "-w"),
+        sp::Request(sp::ModProf().bind(sp::StrRef(sinks.output)), "-o"),
+        sp::Request(sp::ModProf().bind(sp::StrArr(sinks.files, sinks.file_count)), "files")
+    );
+}
+
+template <std::size_t N>
+void parse(decltype(make_context(std::declval<Sinks&>()))& rctx, const char* (&argv)[N], sp::FlagType flags = 0) {
+    rctx.reset();
+    sp::parser::parse(rctx.mapper, argv, static_cast<int>(N), sp::parser::DumpSize<8>{}, flags);
+}
+
+int main() {
+    Sinks sinks;
+
+    // context construction
+    expect_allocations(0, "make_rctx with 6 requests", [&] { auto rctx = make_context(sinks); });
+    expect_allocations(0, "TypedRuntimeContext", [] { sp::TypedRuntimeContext<sctx> typed; });
+    expect_error<sp::except::SetupError>(0, "make_rctx with an unregistered name", sp::except::ErrorKind::UnregisteredName, [] {
+        auto rctx = sp::make_rctx(sctx, sp::Request(sp::ModProf(), "--unregistered"));
+    });
+
+    auto rctx = make_context(sinks);
+
+    // successful parses
+    const char* full[] = { "-v", "-n", "42", "--mode", "safe", "-w", "0.5,1.5,2.5", "-o", "out.txt", "a.txt", "b.txt" };
+    const char* equals[] = { "--count=7", "--output=out.txt", "a.txt" };
+    const char* abbreviated[] = { "--verb", "--out", "out.txt", "--cou", "3", "a.txt" };
+    expect_allocations(0, "options, choice, list and posargs", [&] { parse(rctx, full); });
+    expect_allocations(0, "--name=value tokens", [&] { parse(rctx, equals); });
+    expect_allocations(0, "abbreviated long names", [&] { parse(rctx, abbreviated, sp::parser::kAllowAbbrev); });
+    expect_allocations(0, "tokenized command string", [&] {
+        char line[] = "-n 5 --output 'my file' \"a b.txt\"";
+        std::array<const char*, 16> tokens{};
+        std::size_t count = sp::tokenizer::tokenize(line, tokens);
+        rctx.reset();
+        sp::parser::parse(rctx.mapper, tokens.data(), static_cast<int>(count), sp::parser::DumpSize<8>{});
+    });
+
+    // failing parses
+    const char* unknown[] = { "--unknown", "-o", "out.txt" };
+    const char* missing_narg[] = { "-o" };
+    const char* not_a_number[] = { "-n", "x", "-o", "out.txt" };
+    const char* bad_choice[] = { "-m", "slow", "-o", "out.txt" };
+    const char* bad_element[] = { "-w", "1,x,3", "-o", "out.txt" };
+    const char* missing_required[] = { "-v", "a.txt" };
+    const char* ambiguous[] = { "--co", "-o", "out.txt", "a.txt" };
+    expect_error<sp::except::ParseError>(0, "unknown flag", sp::except::ErrorKind::UnknownFlag, [&] { parse(rctx, unknown); });
+    expect_error<sp::except::ParseError>(0, "missing narg", sp::except::ErrorKind::InsufficientNarg, [&] { parse(rctx, missing_narg); });
+    expect_error<sp::except::ParseError>(0, "not a number", sp::except::ErrorKind::NotANumber, [&] { parse(rctx, not_a_number); });
+    expect_error<sp::except::ParseError>(0, "invalid choice", sp::except::ErrorKind::InvalidChoice, [&] { parse(rctx, bad_choice); });
+    expect_error<sp::except::ParseError>(0, "bad list element", sp::except::ErrorKind::NotANumber, [&] { parse(rctx, bad_element); });
+    expect_error<sp::except::ParseError>(0, "missing required option", sp::except::ErrorKind::MissingRequired, [&] { parse(rctx, missing_required); });
+    expect_error<sp::except::ParseError>(0, "ambiguous abbreviation", sp::except::ErrorKind::AmbiguousFlag, [&] { parse(rctx, ambiguous, sp::parser::kAllowAbbrev); });
+
+    if(failures) std::printf("%d step(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,60 @@
+/*
+Call limit test
+
+Options without call_lim() can be repeated as before limits were enforced,
+call_lim(n) rejects call n + 1 with ErrorKind::CallLimit.
+Exits 1 on the first mismatch.
+
+    g++ -std=c++20 -I<frozen>/include tests/call_limit_test.cpp -o call_limit_test && ./call_limit_test
+*/
+#include "../static_parser.hpp"
+
+#include <cstdio>
+#include <optional>
+
+static int failures = 0;
+
+constexpr sp::StaticContext sctx{
+    sp::dnOpt()["-v"]("--verbose").nargs(0).convert(sp::kCodeNone),
+    sp::dnOpt()["-n"]("--count").nargs(1).convert(sp::kCodeInt).restricted(),
+    sp::dnOpt()["-q"]("--quiet").nargs(0).convert(sp::kCodeNone).call_lim(1),
+    sp::dnOpt()["-j"]("--jobs").nargs(1).convert(sp::kCodeInt).restricted().call_lim(2)
+};
+
+// nullopt when the command line parses, the error kind otherwise
+std::optional<sp::except::ErrorKind> run(std::initializer_list<const char*> args, sp::IntT& count) {
+    sp::IntT jobs = 0;
+    auto rctx = sp::make_rctx(sctx,
+        sp::Request(sp::ModProf().bind(sp::IntRef(count)), "-n"),
+        sp::Request(sp::ModProf().bind(sp::IntRef(jobs)), "-j")
+    );
+    std::array<const char*, 8> argv{};
+    std::size_t argc = 0;
+    for(const char* arg : args) argv[argc++] = arg;
+    try {
+        sp::parser::parse(rctx.mapper, argv.data(), static_cast<int>(argc), sp::parser::DumpSize<1>{});
+    } catch(const sp::except::ParseError& err) {
+        return err.kind();
+    }
+    return std::nullopt;
+}
+
+void expect(const char* name, std::initializer_list<const char*> args, std::optional<sp::except::ErrorKind> kind) {
+    sp::IntT count = 0;
+    std::optional<sp::except::ErrorKind> got = run(args, count);
+    bool ok = (got == kind);
+    std::printf("%-32s %s%s\n", name, got ? "throws" : "parses", ok ? "" : "  <- FAILED");
+    if(!ok) ++failures;
+}
+
+int main() {
+    expect("repeated flag", {"-v", "-v"}, std::nullopt);
+    expect("repeated option", {"-n", "5", "-n", "6"}, std::nullopt);
+    expect("call_lim(1) once", {"-q"}, std::nullopt);
+    expect("call_lim(1) twice", {"-q", "--quiet"}, sp::except::ErrorKind::CallLimit);
+    expect("call_lim(2) twice", {"-j", "1", "-j", "2"}, std::nullopt);
+    expect("call_lim(2) three times", {"-j", "1", "-j", "2", "-j", "3"}, sp::except::ErrorKind::CallLimit);
+
+    if(failures) std::printf("%d failure(s)\n", failures);
+    return failures ? 1 : 0;
+}
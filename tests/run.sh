@@ -0,0 +1,16 @@
+#!/bin/sh
+# Builds and runs every test of this directory, stops at the first failure
+#   FROZEN_INCLUDE=/path/to/frozen/include sh tests/run.sh
+set -e
+here=$(cd "$(dirname "$0")" && pwd)
+out=${TEST_OUT:-"${TMPDIR:-/tmp}/static_parser_tests"}
+mkdir -p "$out"
+CXX=${CXX:-g++}
+CXXFLAGS="-std=c++20 -O2 -pthread ${FROZEN_INCLUDE:+-I$FROZEN_INCLUDE}"
+
+for src in "$here"/*.cpp; do
+    name=$(basename "$src" .cpp)
+    echo "== $name"
+    $CXX $CXXFLAGS "$src" -o "$out/$name"
+    "$out/$name"
+done
@@ -0,0 +1,123 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <cstdint>
+#include <span>
+
+#include "commons.hpp"
+#include "exceptions.hpp"
+
+namespace sp {
+
+namespace tokenizer {
+
+/*
+Shell-style splitting of a single command string
+
+The buffer is rewritten in place : quotes and escapes are removed,
+every token is shifted left and terminated by '\0',
+pointers to the tokens are written into the caller slots
+and can be given to parse as argv, nothing is copied or allocated.
+
+Rules follow the POSIX shell ones, without any expansion :
+    whitespace       separates tokens
+    \c               c, literally (\<newline> is removed)
+    'text'           text, literally
+    "text"           text, only \\ \" \$ \` and \<newline> are escapes
+'' and "" produce empty tokens, adjacent parts are joined ("a"'b'c is abc)
+*/
+
+namespace detail {
+    constexpr bool is_space(char c) noexcept {
+        return (c == ' ') or (c == '\t') or (c == '\n') or (c == '\r') or (c == '\v') or (c == '\f');
+    }
+
+    constexpr bool dquote_escapable(char c) noexcept {
+        return (c == '\\') or (c == '"') or (c == '$') or (c == '`') or (c == '\n');
+    }
+}
+
+/*
+buffer[size] must be writable (usually the terminator of the string),
+returns the number of tokens written into slots
+*/
+inline std::size_t tokenize(char* buffer, std::size_t size, std::span<const char*> slots) {
+    std::size_t count = 0;
+    std::size_t r = 0; // read position
+    std::size_t w = 0; // write position, never ahead of r
+
+    while(true) {
+        while(r < size) {
+            if(detail::is_space(buffer[r])) ++r;
+            else if((buffer[r] == '\\') && ((r + 1) < size) && (buffer[r + 1] == '\n')) r += 2;
+            else break;
+        }
+        if(r == size) break;
+
+        if(count == slots.size())
+            throw except::ParseError(except::Diagnostic{
+                .kind = except::ErrorKind::TooManyTokens,
+                .offset = static_cast<std::uint32_t>(r),
+                .amount = static_cast<std::int64_t>(slots.size())
+            });
+
+        char* token = buffer + w;
+        while((r < size) && !detail::is_space(buffer[r])) {
+            char c = buffer[r++];
+            if(c == '\\') {
+                if(r == size)
+                    throw except::ParseError(except::Diagnostic{
+                        .kind = except::ErrorKind::DanglingEscape,
+                        .offset = static_cast<std::uint32_t>(r - 1)
+                    });
+                if(buffer[r] != '\n') buffer[w++] = buffer[r];
+                ++r;
+            } else if(c == '\'') {
+                const void* close = std::memchr(buffer + r, '\'', size - r);
+                if(!close)
+                    throw except::ParseError(except::Diagnostic{
+                        .kind = except::ErrorKind::UnterminatedQuote,
+                        .offset = static_cast<std::uint32_t>(r - 1),
+                        .other_name = "single"
+                    });
+                std::size_t len = static_cast<const char*>(close) - (buffer + r);
+                std::memmove(buffer + w, buffer + r, len);
+                w += len;
+                r += len + 1;
+            } else if(c == '"') {
+                std::size_t open = r - 1;
+                while(true) {
+                    if(r == size)
+                        throw except::ParseError(except::Diagnostic{
+                            .kind = except::ErrorKind::UnterminatedQuote,
+                            .offset = static_cast<std::uint32_t>(open),
+                            .other_name = "double"
+                        });
+                    c = buffer[r++];
+                    if(c == '"') break;
+                    if((c == '\\') && (r < size) && detail::dquote_escapable(buffer[r])) {
+                        c = buffer[r++];
+                        if(c == '\n') continue;
+                    }
+                    buffer[w++] = c;
+                }
+            } else {
+                buffer[w++] = c;
+            }
+        }
+
+        // w <= r, the terminator never overwrites unread input
+        buffer[w++] = '\0';
+        slots[count++] = token;
+        if(r < size) ++r;
+    }
+    return count;
+}
+
+// buffer is a mutable null-terminated string
+inline std::size_t tokenize(char* buffer, std::span<const char*> slots) {
+    return tokenize(buffer, std::strlen(buffer), slots);
+}
+
+}
+}
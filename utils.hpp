@@ -1,5 +1,15 @@
 #pragma once
 #include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <string_view>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "commons.hpp"
 namespace sp {
 namespace utils {
 
@@ -26,7 +36,7 @@ constexpr std::array<bool, 256> identifier_make_table(){
     return data;
 }
 
-constexpr auto identifier_char_table = identifier_make_table();
+inline constexpr auto identifier_char_table = identifier_make_table();
 
 
 constexpr bool valid_long_opt_name(const char* name, char flag_pref)
@@ -66,5 +76,153 @@ constexpr bool valid_posarg_name(const char* name)
     return true;
 }
 
+// FNV-1a, fast non-cryptographic hash, seed allows chaining over several inputs
+inline constexpr std::uint64_t fnv_offset = 14695981039346656037ull;
+
+constexpr std::uint64_t fnv1a(const char* data, std::size_t size, std::uint64_t seed = fnv_offset) noexcept {
+    for(std::size_t i = 0; i < size; i++) {
+        seed ^= static_cast<unsigned char>(data[i]);
+        seed *= 1099511628211ull;
+    }
+    return seed;
+}
+
+/*
+Bit-word helpers
+
+Runtime state that is scanned as a whole (called set, required set)
+is kept as packed words, so a check over every profile
+costs one operation per 64 profiles
+*/
+
+inline constexpr std::size_t word_bits = std::numeric_limits<BitWord>::digits;
+inline constexpr std::size_t npos_bit = static_cast<std::size_t>(-1);
+
+constexpr std::size_t bit_words(std::size_t bits) noexcept {
+    return (bits + word_bits - 1) / word_bits;
+}
+
+constexpr void bit_set(std::span<BitWord> words, std::size_t i) noexcept {
+    words[i / word_bits] |= (BitWord(1) << (i % word_bits));
+}
+
+constexpr bool bit_test(std::span<const BitWord> words, std::size_t i) noexcept {
+    return ((words[i / word_bits] >> (i % word_bits)) & 1) != 0;
+}
+
+constexpr void bit_clear_all(std::span<BitWord> words) noexcept {
+    for(auto& w : words) w = 0;
+}
+
+// index of the first bit set in (a & ~b), npos_bit if none
+constexpr std::size_t first_and_not(std::span<const BitWord> a, std::span<const BitWord> b) noexcept {
+    for(std::size_t w = 0; w < a.size(); w++) {
+        BitWord diff = a[w] & ~b[w];
+        if(diff) return (w * word_bits) + std::countr_zero(diff);
+    }
+    return npos_bit;
+}
+
+constexpr bool any_and(std::span<const BitWord> a, std::span<const BitWord> b) noexcept {
+    for(std::size_t w = 0; w < a.size(); w++)
+        if(a[w] & b[w]) return true;
+    return false;
+}
+
+constexpr std::size_t popcount_and(std::span<const BitWord> a, std::span<const BitWord> b) noexcept {
+    std::size_t res = 0;
+    for(std::size_t w = 0; w < a.size(); w++)
+        res += std::popcount(a[w] & b[w]);
+    return res;
+}
+
+// index of the n-th (0 based) bit set in (a & b), npos_bit if none
+constexpr std::size_t nth_and(std::span<const BitWord> a, std::span<const BitWord> b, std::size_t n) noexcept {
+    for(std::size_t w = 0; w < a.size(); w++) {
+        BitWord curr = a[w] & b[w];
+        while(curr) {
+            if(!n--) return (w * word_bits) + std::countr_zero(curr);
+            curr &= (curr - 1);
+        }
+    }
+    return npos_bit;
+}
+
+template <typename F>
+constexpr void for_each_bit(std::span<const BitWord> words, F&& func) {
+    for(std::size_t w = 0; w < words.size(); w++) {
+        BitWord curr = words[w];
+        while(curr) {
+            func((w * word_bits) + std::countr_zero(curr));
+            curr &= (curr - 1);
+        }
+    }
+}
+
+/*
+Delimiter scan of list values (--ids=1,2,3)
+
+16 bytes are compared at once with SSE2 (every x86-64 target has it),
+each match is taken from the movemask bits, byte by byte elsewhere
+and for the tail
+*/
+
+// calls func(pos) for every position of c in data[0, size), in order
+template <typename F>
+inline void for_each_byte(const char* data, std::size_t size, char c, F&& func) {
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i needle = _mm_set1_epi8(c);
+    for(; (i + 16) <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)));
+        while(mask) {
+            func(i + std::countr_zero(mask));
+            mask &= (mask - 1);
+        }
+    }
+#endif
+    for(; i < size; i++)
+        if(data[i] == c) func(i);
+}
+
+inline std::size_t count_byte(std::string_view text, char c) noexcept {
+    std::size_t res = 0;
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i needle = _mm_set1_epi8(c);
+    for(; (i + 16) <= text.size(); i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + i));
+        res += std::popcount(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle))));
+    }
+#endif
+    for(; i < text.size(); i++)
+        if(text[i] == c) ++res;
+    return res;
+}
+
+// calls func(field) for every delim separated field of text, empty fields included
+template <typename F>
+inline void for_each_field(std::string_view text, char delim, F&& func) {
+    std::size_t start = 0;
+    for_each_byte(text.data(), text.size(), delim, [&](std::size_t pos) {
+        func(text.substr(start, pos - start));
+        start = pos + 1;
+    });
+    func(text.substr(start));
+}
+
+// string literal usable as a template argument : get<"--output">()
+template <std::size_t N>
+struct FixedString {
+    char data[N]{};
+
+    constexpr FixedString(const char (&str)[N]) {
+        for(std::size_t i = 0; i < N; i++) data[i] = str[i];
+    }
+
+    constexpr std::string_view view() const noexcept { return std::string_view(data, N - 1); }
+};
+
 }
 }
\ No newline at end of file
@@ -1,13 +1,19 @@
 #pragma once
 
+#include <array>
+#include <functional>
+#include <span>
+#include <string_view>
 #include <variant>
 #include <type_traits>
 #include <bit>
+#include <cstddef>
 #include <cstdint>
 
 #include "commons.hpp"
 #include "exceptions.hpp"
 #include "flagging.hpp"
+#include "utils.hpp"
 
 namespace sp {
 namespace values {
@@ -26,18 +32,22 @@ the criteria above, with just a little specialty
 namespace type_code {
 	class Tcode : public sp::flagging::BaseFlag<std::uint8_t, Tcode> { using BaseFlag::BaseFlag; };
 
-	constexpr Tcode ref_category(0b1 << 0);
-	constexpr Tcode arr_category(0b1 << 1);
-	constexpr Tcode none = Tcode();
-	constexpr Tcode category_fields(0b1111);
-	constexpr int field_size = std::popcount(category_fields.value());
+	inline constexpr Tcode ref_category(0b1 << 0);
+	inline constexpr Tcode arr_category(0b1 << 1);
+	inline constexpr Tcode custom_category(0b1 << 2);
+	inline constexpr Tcode none = Tcode();
+	inline constexpr Tcode category_fields(0b1111);
+	inline constexpr int field_size = std::popcount(category_fields.value());
 
-	constexpr Tcode kInt = Tcode(0b1 << field_size) | ref_category;
-	constexpr Tcode kDob = Tcode(0b10 << field_size) | ref_category;
-	constexpr Tcode kStr = Tcode(0b100 << field_size) | ref_category;
+	inline constexpr Tcode kInt = Tcode(0b1 << field_size) | ref_category;
+	inline constexpr Tcode kDob = Tcode(0b10 << field_size) | ref_category;
+	inline constexpr Tcode kStr = Tcode(0b100 << field_size) | ref_category;
+	inline constexpr Tcode kChoice = Tcode(0b1000 << field_size) | ref_category; // index of the matched choice, stored as IntT
 
-	constexpr Tcode kRangedArr = Tcode(0b1 << field_size) |  arr_category;
-	constexpr Tcode kDynamicArr = Tcode(0b10 << field_size) | arr_category;
+	inline constexpr Tcode kRangedArr = Tcode(0b1 << field_size) |  arr_category;
+	inline constexpr Tcode kDynamicArr = Tcode(0b10 << field_size) | arr_category;
+
+	inline constexpr Tcode kCustom = Tcode(0b1 << field_size) | custom_category; // converted by a values::Converter
 
 	constexpr bool is_array(const Tcode& code) noexcept {
 		return code.has(arr_category);
@@ -47,16 +57,80 @@ namespace type_code {
 		return code.has(ref_category);
 	}
 
-	const char* code_to_str(const Tcode& code) noexcept {
+	constexpr const char* code_to_str(const Tcode& code) noexcept {
 		switch(code.value()){
 			case kInt.value() : return "<INT_REF>";
 			case kDob.value() : return "<DOUBLE_REF>";
 			case kStr.value() : return "<STRING_REF>";
+			case kChoice.value() : return "<CHOICE_REF>";
+			case kCustom.value() : return "<CUSTOM>";
 			case kRangedArr.value() : return "<RANGED_ARRAY>";
 			case kDynamicArr.value() : return "<DYNAMIC_ARRAY>";
 			default : return "<UNKNOWN_TCODE>";
 		}
 	}
+
+	// human name of the value type a code converts to, used by diagnostics
+	constexpr const char* type_name(const Tcode& code) noexcept {
+		switch(code.value()) {
+			case kInt.value() : return "int";
+			case kDob.value() : return "double";
+			case kStr.value() : return "string";
+			case kChoice.value() : return "choice";
+			default : return nullptr;
+		}
+	}
+
+	// code of the sink able to receive the converted values
+	constexpr Tcode sink_code(const Tcode& code) noexcept {
+		return (code == kChoice) ? kInt : code;
+	}
+}
+
+// one address per type, identifies the value type of converters and custom sinks
+template <typename T>
+inline constexpr char type_tag = 0;
+
+/*
+User-defined conversion of a kCustom profile
+
+convert parses token and writes the value into out, which points to
+a value of size value_size inside the bound sink (see TrackingCustom),
+it returns false on invalid input. Build converters with make_converter,
+they are constexpr and referenced by the profile, nothing is allocated.
+*/
+struct Converter {
+	const char* name = "custom";
+	std::size_t value_size = 0;
+	bool (*convert)(std::string_view token, void* out) = nullptr;
+	const void* value_type = nullptr; // &type_tag<T>
+};
+
+// Fn : bool(std::string_view, T&), a function or a captureless lambda
+template <typename T, auto Fn>
+constexpr Converter make_converter(const char* name) noexcept {
+	return Converter{
+		name,
+		sizeof(T),
+		[](std::string_view token, void* out) -> bool { return Fn(token, *static_cast<T*>(out)); },
+		&type_tag<std::remove_cv_t<T>>
+	};
+}
+
+// what the parser hands to the sinks of kCustom profiles
+struct CustomToken {
+	std::string_view text;
+	const Converter* converter = nullptr;
+	const except::Diagnostic* where = nullptr;
+};
+
+template <typename T>
+constexpr const char* type_name_of() noexcept {
+	if constexpr (std::is_same_v<T, IntT>) return "int";
+	else if constexpr (std::is_same_v<T, DobT>) return "double";
+	else if constexpr (std::is_same_v<T, StrT>) return "string";
+	else if constexpr (std::is_same_v<T, CustomToken>) return "custom";
+	else return "<UNKNOWN_TYPE>";
 }
 
 constexpr bool is_arr_ctgry(const type_code::Tcode& code) noexcept {
@@ -105,9 +179,32 @@ struct TrackingSpan {
 		return true;
 	}
 
+	// custom values can't be held by a Blob
+	bool push_back(CustomToken&) {
+		throw except::ParseError(except::Diagnostic{
+			.kind = except::ErrorKind::WrongType,
+			.other_name = "custom"
+		});
+	}
+
+	// bulk string insertion, stores as many of run as fit, returns how many
+	std::size_t append(std::span<const StrT> run) noexcept {
+		std::size_t amount = viewer.size() - curr_idx;
+		if(run.size() < amount) amount = run.size();
+		for(std::size_t i = 0; i < amount; i++)
+			viewer[curr_idx + i] = run[i];
+		curr_idx += amount;
+		return amount;
+	}
+
 	void track_reset() noexcept { curr_idx = 0; }
+	void track_clear() noexcept {
+		for(auto& val : viewer) val = Blob{};
+		curr_idx = 0;
+	}
 
 	std::size_t consume_amount() const noexcept { return viewer.size(); }
+	std::size_t room() const noexcept { return viewer.size() - curr_idx; }
 };
 
 template <typename T>
@@ -139,12 +236,18 @@ struct TrackingReference {
 
 	template <typename ParamType>
 	bool push_back(const ParamType& _) {
-		std::string signature = __PRETTY_FUNCTION__;
-		signature = signature.substr(signature.find('['));
-		throw except::ParseError("Wrong type : " + signature);
+		throw except::ParseError(except::Diagnostic{
+			.kind = except::ErrorKind::WrongType,
+			.other_name = type_name_of<std::decay_t<ParamType>>(),
+			.expected = type_name_of<T>()
+		});
 	}
 
 	void track_reset() noexcept { filled = false; }
+	void track_clear() noexcept {
+		ref.get() = T{};
+		filled = false;
+	}
 	std::size_t consume_amount() const noexcept { return 1; }
 };
 
@@ -152,6 +255,232 @@ using IntRef = TrackingReference<IntT>;
 using DobRef = TrackingReference<DobT>;
 using StrRef = TrackingReference<StrT>;
 
+/*
+Typed counterpart of TrackingSpan,
+values are stored without Blob and the amount of
+inserted values is written back into a bound counter
+*/
+template <typename T>
+struct TrackingArray {
+	std::span<T> viewer;
+	std::reference_wrapper<std::size_t> used;
+
+	TrackingArray(std::span<T> view, std::size_t& count) : viewer(view), used(count) {}
+
+	template <std::size_t N>
+	TrackingArray(std::array<T, N>& arr, std::size_t& count) : viewer(arr), used(count) {}
+
+	bool push_back(const T& val) {
+		if(used.get() >= viewer.size())
+			return false;
+		viewer[used.get()++] = val;
+		return true;
+	}
+
+	template <typename ParamType>
+	bool push_back(const ParamType&) {
+		throw except::ParseError(except::Diagnostic{
+			.kind = except::ErrorKind::WrongType,
+			.other_name = type_name_of<std::decay_t<ParamType>>(),
+			.expected = type_name_of<T>()
+		});
+	}
+
+	std::size_t append(std::span<const StrT> run) noexcept requires std::is_same_v<T, StrT> {
+		std::size_t amount = viewer.size() - used.get();
+		if(run.size() < amount) amount = run.size();
+		for(std::size_t i = 0; i < amount; i++)
+			viewer[used.get() + i] = run[i];
+		used.get() += amount;
+		return amount;
+	}
+
+	// hands out the next n slots (n <= room()) to be written directly
+	std::span<T> claim(std::size_t n) noexcept {
+		std::span<T> res = viewer.subspan(used.get(), n);
+		used.get() += n;
+		return res;
+	}
+
+	void track_reset() noexcept { used.get() = 0; }
+	void track_clear() noexcept {
+		for(auto& val : viewer) val = T{};
+		used.get() = 0;
+	}
+	std::size_t consume_amount() const noexcept { return viewer.size(); }
+	std::size_t room() const noexcept { return viewer.size() - used.get(); }
+};
+
+using IntArr = TrackingArray<IntT>;
+using DobArr = TrackingArray<DobT>;
+using StrArr = TrackingArray<StrT>;
+
+/*
+Sink of kCustom profiles, a type-erased view over caller typed storage :
+a single variable or an array with a bound counter.
+The Converter of the profile writes straight into it,
+verify() checks the value types match.
+track_clear assigns T{} to every slot when T allows it
+*/
+struct TrackingCustom {
+	std::byte* base = nullptr;
+	std::size_t stride = 0;
+	std::size_t capacity = 0;
+	std::size_t filled = 0;
+	std::size_t* counter = nullptr; // bound counter of arrays, filled is used otherwise
+	const void* value_type = nullptr; // &type_tag<T>
+	void (*clear_values)(std::byte* first, std::size_t amount) noexcept = nullptr;
+
+	template <typename T>
+	static constexpr auto clear_of() noexcept {
+		using Fn = void (*)(std::byte*, std::size_t) noexcept;
+		if constexpr (std::is_nothrow_default_constructible_v<T> && std::is_nothrow_move_assignable_v<T>)
+			return static_cast<Fn>([](std::byte* first, std::size_t amount) noexcept {
+				for(std::size_t i = 0; i < amount; i++) reinterpret_cast<T*>(first)[i] = T{};
+			});
+		else
+			return static_cast<Fn>(nullptr);
+	}
+
+	template <typename T>
+		requires (!std::is_same_v<std::remove_cv_t<T>, TrackingCustom>)
+	TrackingCustom(T& var)
+		: base(reinterpret_cast<std::byte*>(&var)), stride(sizeof(T)), capacity(1),
+		  value_type(&type_tag<std::remove_cv_t<T>>), clear_values(clear_of<T>()) {}
+
+	template <typename T, std::size_t N>
+	TrackingCustom(std::array<T, N>& arr, std::size_t& count)
+		: base(reinterpret_cast<std::byte*>(arr.data())), stride(sizeof(T)), capacity(N), counter(&count),
+		  value_type(&type_tag<std::remove_cv_t<T>>), clear_values(clear_of<T>()) {}
+
+	std::size_t& used() noexcept { return counter ? *counter : filled; }
+
+	bool push_back(const CustomToken& tok) {
+		std::size_t& count = used();
+		if(count >= capacity)
+			return false;
+		if(!tok.converter->convert(tok.text, base + (count * stride))) {
+			except::Diagnostic diag = tok.where ? *tok.where : except::Diagnostic{};
+			diag.kind = except::ErrorKind::ConversionFailed;
+			diag.token = tok.text;
+			diag.expected = tok.converter->name;
+			throw except::ParseError(diag);
+		}
+		++count;
+		return true;
+	}
+
+	template <typename ParamType>
+	bool push_back(const ParamType&) {
+		throw except::ParseError(except::Diagnostic{
+			.kind = except::ErrorKind::WrongType,
+			.other_name = type_name_of<std::decay_t<ParamType>>(),
+			.expected = "custom"
+		});
+	}
+
+	void track_reset() noexcept { used() = 0; }
+	void track_clear() noexcept {
+		if(clear_values) clear_values(base, capacity);
+		used() = 0;
+	}
+	std::size_t consume_amount() const noexcept { return capacity; }
+	std::size_t room() const noexcept { return capacity - (counter ? *counter : filled); }
+};
+
+// value type a convert code produces, void when nothing is converted
+template <std::uint8_t Code>
+struct code_value { using type = void; };
+template <> struct code_value<type_code::kInt.value()> { using type = IntT; };
+template <> struct code_value<type_code::kDob.value()> { using type = DobT; };
+template <> struct code_value<type_code::kStr.value()> { using type = StrT; };
+template <> struct code_value<type_code::kChoice.value()> { using type = IntT; };
+
+/*
+Allowed values of a kChoice profile,
+a token is mapped to its declaration index with a single
+seeded FNV-1a probe, the seed is searched at compile time
+so every choice lands in its own slot (perfect hash)
+*/
+struct ChoiceTable {
+	std::span<const char* const> names;
+	std::span<const std::uint8_t> slots; // declaration index + 1, 0 for an empty slot
+	std::uint64_t seed = utils::fnv_offset;
+
+	constexpr NumT find(std::string_view token) const noexcept {
+		std::size_t slot = utils::fnv1a(token.data(), token.size(), seed) & (slots.size() - 1);
+		std::uint8_t idx = slots[slot];
+		if(!idx or (std::string_view(names[idx - 1]) != token)) return -1;
+		return static_cast<NumT>(idx - 1);
+	}
+
+	constexpr std::size_t size() const noexcept { return names.size(); }
+	constexpr const char* name(std::size_t idx) const noexcept { return names[idx]; }
+};
+
+template <utils::FixedString... Names>
+struct ChoiceSet {
+	static_assert(sizeof...(Names) > 0, "A choice set needs at least one name");
+	static_assert(sizeof...(Names) < 256, "A choice set holds at most 255 names");
+
+	static constexpr std::size_t slot_count = std::bit_ceil(sizeof...(Names) * 2);
+	static constexpr std::array<const char*, sizeof...(Names)> names{ Names.data... };
+
+	struct Layout {
+		std::array<std::uint8_t, slot_count> slots{};
+		std::uint64_t seed = 0;
+	};
+
+	static constexpr Layout build() {
+		for(std::uint64_t attempt = 0;; attempt++) {
+			Layout layout{};
+			layout.seed = utils::fnv_offset + attempt;
+			bool perfect = true;
+			for(std::size_t i = 0; perfect && (i < names.size()); i++) {
+				std::string_view name(names[i]);
+				for(std::size_t j = 0; j < i; j++)
+					if(std::string_view(names[j]) == name)
+						throw except::comtime_except("Duplicated name in choice set");
+				std::size_t slot = utils::fnv1a(name.data(), name.size(), layout.seed) & (slot_count - 1);
+				if(layout.slots[slot]) perfect = false;
+				else layout.slots[slot] = static_cast<std::uint8_t>(i + 1);
+			}
+			if(perfect) return layout;
+		}
+	}
+
+	static constexpr Layout layout = build();
+	static constexpr ChoiceTable table{names, layout.slots, layout.seed};
+
+	// declaration index of name, usable to compare against the parsed IntT
+	static constexpr IntT index(std::string_view name) {
+		NumT idx = table.find(name);
+		if(idx < 0) throw except::comtime_except("Name is not part of the choice set");
+		return idx;
+	}
+};
+
+/*
+Owned typed storage of a single profile (see TypedRuntimeContext),
+Capacity 0 stores nothing, Single stores one value, otherwise an array
+*/
+template <typename T, std::size_t Capacity, bool Single>
+struct TypedSlot {
+	std::array<T, Capacity> values{};
+	std::size_t used = 0;
+
+	TrackingArray<T> sink() noexcept { return TrackingArray<T>(values, used); }
+	std::span<const T> get() const noexcept { return std::span<const T>(values.data(), used); }
+};
+
+template <typename T, std::size_t Capacity>
+struct TypedSlot<T, Capacity, true> {
+	T value{};
+
+	TrackingReference<T> sink() noexcept { return TrackingReference<T>(value); }
+	const T& get() const noexcept { return value; }
+};
+
 template <typename GetType, typename VariantType>
 GetType& ce_get(VariantType& ins, std::string_view error_msg) {  // Custom Error
 	if(std::holds_alternative<GetType>(ins))
@@ -168,11 +497,17 @@ class BoundValue {
 		IntRef,
 		DobRef,
 		StrRef,
-		TrackingSpan
+		TrackingSpan,
+		IntArr,
+		DobArr,
+		StrArr,
+		TrackingCustom
 	>;
 
 	val_type value;
 
+	public :
+
 	void reset() {
 		std::visit([](auto&& arg){
 			using T = std::decay_t<decltype(arg)>;
@@ -183,7 +518,15 @@ class BoundValue {
 		
 	}
 
-	public :
+	// reset() and every bound value assigned back to its default
+	void clear() noexcept {
+		std::visit([](auto&& arg){
+			using T = std::decay_t<decltype(arg)>;
+			if constexpr (!std::is_same_v<T, std::monostate>) {
+				arg.track_clear();
+			}
+		}, this->value);
+	}
 
 	auto opc() { // open parsing context
 		this->reset();
@@ -203,6 +546,33 @@ class BoundValue {
 	typename std::enable_if_t<within_variant<std::decay_t<T>, val_type>::value, void>
 	bind(T ref) { this->value = ref; }
 
+	// visits every value currently tracked by the bound sink
+	template <typename F>
+	void for_each_value(F&& func) const {
+		std::visit([&func](auto&& arg) {
+			using T = std::decay_t<decltype(arg)>;
+			if constexpr (std::is_same_v<T, TrackingSpan>) {
+				for(std::size_t i = 0; i < arg.curr_idx; i++) func(arg.viewer[i]);
+			} else if constexpr (std::is_same_v<T, IntArr> or std::is_same_v<T, DobArr> or std::is_same_v<T, StrArr>) {
+				for(std::size_t i = 0; i < arg.used.get(); i++) func(Blob(arg.viewer[i]));
+			} else if constexpr (std::is_same_v<T, TrackingCustom>) {
+				// custom values have no Blob form
+			} else if constexpr (!std::is_same_v<T, std::monostate>) {
+				if(arg.filled) func(Blob(arg.ref.get()));
+			}
+		}, this->value);
+	}
+
+	// calls func with the bound sink itself (std::monostate when unbound)
+	template <typename F>
+	decltype(auto) visit_sink(F&& func) { return std::visit(std::forward<F>(func), this->value); }
+
+	// value type tag of a TrackingCustom sink, nullptr for any other sink
+	const void* custom_type() const noexcept {
+		const TrackingCustom* sink = std::get_if<TrackingCustom>(&this->value);
+		return sink ? sink->value_type : nullptr;
+	}
+
 	std::size_t consume_amnt() const noexcept {
 		return std::visit([](auto&& arg) -> std::size_t {
 			using T = std::decay_t<decltype(arg)>;
@@ -222,6 +592,9 @@ class BoundValue {
 			if constexpr (std::is_same_v<T, DobRef>) return values::type_code::kDob;
 			if constexpr (std::is_same_v<T, StrRef>) return values::type_code::kStr;
 			if constexpr (std::is_same_v<T, TrackingSpan>) return values::type_code::kRangedArr;
+			if constexpr (std::is_same_v<T, IntArr> or std::is_same_v<T, DobArr> or std::is_same_v<T, StrArr>)
+				return values::type_code::kRangedArr;
+			if constexpr (std::is_same_v<T, TrackingCustom>) return values::type_code::kCustom;
 			else return values::type_code::Tcode();
 		}, this->value);
 	}
@@ -229,8 +602,10 @@ class BoundValue {
 
 }
 using TypeCodeT = values::type_code::Tcode;
-const TypeCodeT& kCodeNone = values::type_code::none;
-const TypeCodeT& kCodeInt = values::type_code::kInt;
-const TypeCodeT& kCodeDob = values::type_code::kDob;
-const TypeCodeT& kCodeStr = values::type_code::kStr;
+inline constexpr TypeCodeT kCodeNone = values::type_code::none;
+inline constexpr TypeCodeT kCodeInt = values::type_code::kInt;
+inline constexpr TypeCodeT kCodeDob = values::type_code::kDob;
+inline constexpr TypeCodeT kCodeStr = values::type_code::kStr;
+inline constexpr TypeCodeT kCodeChoice = values::type_code::kChoice;
+inline constexpr TypeCodeT kCodeCustom = values::type_code::kCustom;
 }